@@ -10,10 +10,13 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Materials/Material.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
 #include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "../Game/TPSGameInstance.h"
+#include "../Game/TPSLagCompensationSubsystem.h"
+#include "../StateEffects/TPSStateEffectSubsystem.h"
 #include "../TPS.h"
 #include "../Weapon/ProjectileDefault.h"
 #include "Net/UnrealNetwork.h"
@@ -55,6 +58,40 @@ ATPSCharacter::ATPSCharacter()
 	CharacterInventoryComponent = CreateDefaultSubobject<UTPSInventoryComponent>(TEXT("InventoryComponent"));
 	CharacterHealthComponent = CreateDefaultSubobject<UTPSCharacterHealthComponent>(TEXT("HealthComponent"));
 
+	//weapon hit shapes on mannequin bones instead of mesh physics asset
+	CharacterHitProxyComponent = CreateDefaultSubobject<UTPSHitProxyComponent>(TEXT("HitProxyComponent"));
+	if (CharacterHitProxyComponent)
+	{
+		static ConstructorHelpers::FObjectFinder<UPhysicalMaterial> BloodPhysMaterial(TEXT("/Game/TPS/Recurces/Materials/Blood"));
+		if (BloodPhysMaterial.Succeeded())
+			CharacterHitProxyComponent->PhysMaterial = BloodPhysMaterial.Object;
+
+		FTPSHitProxyShape HeadShape;
+		HeadShape.Bone = TEXT("head");
+		HeadShape.Shape = ETPSHitProxyShape::Sphere;
+		HeadShape.Extent = FVector(14.0f);
+		HeadShape.Offset.SetLocation(FVector(8.0f, 2.0f, 0.0f));
+		HeadShape.DamageMultiplier = 2.0f;
+		CharacterHitProxyComponent->Shapes.Add(HeadShape);
+
+		FTPSHitProxyShape BodyShape;
+		BodyShape.Bone = TEXT("spine_02");
+		BodyShape.Extent = FVector(24.0f, 24.0f, 40.0f);
+		BodyShape.Offset.SetRotation(FRotator(90.0f, 0.0f, 0.0f).Quaternion());
+		CharacterHitProxyComponent->Shapes.Add(BodyShape);
+
+		//capsule Z along thigh bone X
+		for (const TCHAR* Thigh : { TEXT("thigh_l"), TEXT("thigh_r") })
+		{
+			FTPSHitProxyShape LegShape;
+			LegShape.Bone = Thigh;
+			LegShape.Extent = FVector(12.0f, 12.0f, 45.0f);
+			LegShape.Offset = FTransform(FRotator(90.0f, 0.0f, 0.0f), FVector(35.0f, 0.0f, 0.0f));
+			LegShape.DamageMultiplier = 0.75f;
+			CharacterHitProxyComponent->Shapes.Add(LegShape);
+		}
+	}
+
 	if (CharacterHealthComponent)
 	{
 		CharacterHealthComponent->OnDead.AddDynamic(this, &ATPSCharacter::CharDead);
@@ -62,6 +99,7 @@ ATPSCharacter::ATPSCharacter()
 	if (CharacterInventoryComponent)
 	{
 		CharacterInventoryComponent->OnSwitchWeapon.AddDynamic(this, &ATPSCharacter::InitWeapon);
+		CharacterInventoryComponent->OnUpdateWeaponSlots.AddDynamic(this, &ATPSCharacter::WeaponSlotUpdated);
 	}
 
 	// Activate ticking in order to update the cursor every frame.
@@ -121,6 +159,30 @@ void ATPSCharacter::BeginPlay()
 	{
 		CurrentCursor = UGameplayStatics::SpawnDecalAtLocation(GetWorld(), CursorMaterial, CursorSize, FVector(0));
 	}
+
+	if (HasAuthority())
+	{
+		UTPSLagCompensationSubsystem* myLagCompensation = GetWorld()->GetSubsystem<UTPSLagCompensationSubsystem>();
+		if (myLagCompensation)
+			myLagCompensation->RegisterCharacter(this);
+	}
+}
+
+void ATPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UTPSLagCompensationSubsystem* myLagCompensation = GetWorld() ? GetWorld()->GetSubsystem<UTPSLagCompensationSubsystem>() : nullptr;
+	if (myLagCompensation)
+		myLagCompensation->UnregisterCharacter(this);
+
+	for (AWeaponDefault* myWeapon : SlotWeapons)
+	{
+		if (IsValid(myWeapon))
+			myWeapon->Destroy();
+	}
+	SlotWeapons.Empty();
+	CurrentWeapon = nullptr;
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ATPSCharacter::SetupPlayerInputComponent(UInputComponent* NewInputComponent)
@@ -362,7 +424,7 @@ void ATPSCharacter::AttackCharEvent(bool bIsFiring)
 	if (myWeapon)
 	{
 		//ToDo Check melee or range
-		myWeapon->SetWeaponStateFire_OnServer(bIsFiring);
+		myWeapon->SetWeaponStateFire(bIsFiring);
 	}
 	else
 		UE_LOG(LogTemp, Warning, TEXT("ATPSCharacter::AttackCharEvent - CurrentWeapon -NULL"));
@@ -429,7 +491,7 @@ void ATPSCharacter::ChangeMovementState()
 	AWeaponDefault* myWeapon = GetCurrentWeapon();
 	if (myWeapon)
 	{
-		myWeapon->UpdateStateWeapon_OnServer(NewState);
+		myWeapon->UpdateStateWeapon(NewState);
 	}
 }
 
@@ -440,62 +502,150 @@ AWeaponDefault* ATPSCharacter::GetCurrentWeapon()
 
 void ATPSCharacter::InitWeapon(FName IdWeaponName, FAdditionalWeaponInfo WeaponAdditionalInfo, int32 NewCurrentIndexWeapon)
 {
-	//On Server
+	//On Server, weapon of slot is spawned once and kept while slot have same weapon
 	if (CurrentWeapon)
 	{
-		CurrentWeapon->Destroy();
+		CurrentWeapon->SetWeaponActive(false);
 		CurrentWeapon = nullptr;
 	}
 
-	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
-	FWeaponInfo myWeaponInfo;
-	if (myGI)
+	if (NewCurrentIndexWeapon < 0)
+		return;
+	if (SlotWeapons.Num() <= NewCurrentIndexWeapon)
+		SlotWeapons.SetNumZeroed(NewCurrentIndexWeapon + 1);
+
+	AWeaponDefault* myWeapon = SlotWeapons[NewCurrentIndexWeapon];
+	if (myWeapon && (!IsValid(myWeapon) || myWeapon->IdWeaponName != IdWeaponName))
 	{
-		if (myGI->GetWeaponInfoByName(IdWeaponName, myWeaponInfo))
+		if (IsValid(myWeapon))
+			myWeapon->Destroy();
+		myWeapon = nullptr;
+	}
+
+	if (!myWeapon)
+	{
+		UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+		const FWeaponInfo* myWeaponInfo = myGI ? myGI->FindWeaponInfo(IdWeaponName) : nullptr;
+		if (!myWeaponInfo)
 		{
-			if (myWeaponInfo.WeaponClass)
-			{
-				FVector SpawnLocation = FVector(0);
-				FRotator SpawnRotation = FRotator(0);
+			UE_LOG(LogTemp, Warning, TEXT("ATPSCharacter::InitWeapon - Weapon not found in table - NULL"));
+			return;
+		}
 
-				FActorSpawnParameters SpawnParams;
-				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-				SpawnParams.Owner = this;
-				SpawnParams.Instigator = GetInstigator();
+		//class is streamed with slot assets, take weapon when it come
+		if (!myWeaponInfo->WeaponClass.IsNull() && !myWeaponInfo->WeaponClass.Get())
+		{
+			PendingWeaponIndex = NewCurrentIndexWeapon;
+			myGI->CallWhenWeaponAssetsLoaded(IdWeaponName, FStreamableDelegate::CreateUObject(this, &ATPSCharacter::PendingWeaponAssetsLoaded, IdWeaponName, WeaponAdditionalInfo, NewCurrentIndexWeapon));
+			return;
+		}
 
-				AWeaponDefault* myWeapon = Cast<AWeaponDefault>(GetWorld()->SpawnActor(myWeaponInfo.WeaponClass, &SpawnLocation, &SpawnRotation, SpawnParams));
-				if (myWeapon)
-				{
-					FAttachmentTransformRules Rule(EAttachmentRule::SnapToTarget, false);
-					myWeapon->AttachToComponent(GetMesh(), Rule, FName("WeaponSocketRightHand"));
-					CurrentWeapon = myWeapon;
+		myWeapon = SpawnSlotWeapon(IdWeaponName, *myWeaponInfo);
+		SlotWeapons[NewCurrentIndexWeapon] = myWeapon;
+		if (!myWeapon)
+			return;
+	}
 
-					myWeapon->WeaponSetting = myWeaponInfo;
-					myWeapon->IdWeaponName = IdWeaponName;
+	PendingWeaponIndex = INDEX_NONE;
+	FAttachmentTransformRules Rule(EAttachmentRule::SnapToTarget, false);
+	myWeapon->AttachToComponent(GetMesh(), Rule, FName("WeaponSocketRightHand"));
+	myWeapon->SetWeaponActive(true);
+	CurrentWeapon = myWeapon;
 
-					myWeapon->ReloadTimer = myWeaponInfo.ReloadTime;
-					myWeapon->UpdateStateWeapon_OnServer(MovementState);
+	myWeapon->UpdateStateWeapon_OnServer(MovementState);
+	myWeapon->AdditionalWeaponInfo = WeaponAdditionalInfo;
+	CurrentIndexWeapon = NewCurrentIndexWeapon;
 
-					myWeapon->AdditionalWeaponInfo = WeaponAdditionalInfo;
-					CurrentIndexWeapon = NewCurrentIndexWeapon;
+	// after switch try reload weapon if needed
+	if (CurrentWeapon->GetWeaponRound() <= 0 && CurrentWeapon->CheckCanWeaponReload())
+		CurrentWeapon->InitReload();
 
-					myWeapon->OnWeaponReloadStart.AddDynamic(this, &ATPSCharacter::WeaponReloadStart);
-					myWeapon->OnWeaponReloadEnd.AddDynamic(this, &ATPSCharacter::WeaponReloadEnd);
+	if (CharacterInventoryComponent)
+		CharacterInventoryComponent->OnWeaponAmmoAviable.Broadcast(myWeapon->WeaponSetting.WeaponType);
+}
 
-					myWeapon->OnWeaponFireStart.AddDynamic(this, &ATPSCharacter::WeaponFireStart);
+void ATPSCharacter::PendingWeaponAssetsLoaded(FName IdWeaponName, FAdditionalWeaponInfo WeaponAdditionalInfo, int32 NewCurrentIndexWeapon)
+{
+	//switched to other weapon while this one was streaming
+	if (PendingWeaponIndex != NewCurrentIndexWeapon || CurrentWeapon)
+		return;
+	PendingWeaponIndex = INDEX_NONE;
 
-					// after switch try reload weapon if needed
-					if (CurrentWeapon->GetWeaponRound() <= 0 && CurrentWeapon->CheckCanWeaponReload())
-						CurrentWeapon->InitReload();
+	//class can be still null if it failed to load or was not requested, don't wait again
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+	const FWeaponInfo* myWeaponInfo = myGI ? myGI->FindWeaponInfo(IdWeaponName) : nullptr;
+	if (myWeaponInfo && myWeaponInfo->WeaponClass.Get())
+		InitWeapon(IdWeaponName, WeaponAdditionalInfo, NewCurrentIndexWeapon);
+}
 
-					if (CharacterInventoryComponent)
-						CharacterInventoryComponent->OnWeaponAmmoAviable.Broadcast(myWeapon->WeaponSetting.WeaponType);
-				}
-			}
-		}
-		else
+void ATPSCharacter::OnRep_CurrentWeapon(AWeaponDefault* OldWeapon)
+{
+	if (OldWeapon && OldWeapon != CurrentWeapon)
+	{
+		OldWeapon->WeaponFiring = false;
+	}
+}
+
+AWeaponDefault* ATPSCharacter::SpawnSlotWeapon(FName IdWeaponName, const FWeaponInfo& WeaponInfo)
+{
+	UClass* myWeaponClass = WeaponInfo.WeaponClass.Get();
+	if (!myWeaponClass)
+		return nullptr;
+
+	FVector SpawnLocation = FVector(0);
+	FRotator SpawnRotation = FRotator(0);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.Owner = this;
+	SpawnParams.Instigator = GetInstigator();
+
+	AWeaponDefault* myWeapon = Cast<AWeaponDefault>(GetWorld()->SpawnActor(myWeaponClass, &SpawnLocation, &SpawnRotation, SpawnParams));
+	if (myWeapon)
+	{
+		myWeapon->WeaponSetting = WeaponInfo;
+		myWeapon->IdWeaponName = IdWeaponName;
+		//projectile pool is warmed up when assets are loaded
+		myWeapon->RequestWeaponAssets();
+
+		myWeapon->OnWeaponReloadStart.AddDynamic(this, &ATPSCharacter::WeaponReloadStart);
+		myWeapon->OnWeaponReloadEnd.AddDynamic(this, &ATPSCharacter::WeaponReloadEnd);
+
+		myWeapon->OnWeaponFireStart.AddDynamic(this, &ATPSCharacter::WeaponFireStart);
+	}
+	return myWeapon;
+}
+
+void ATPSCharacter::WeaponSlotUpdated(int32 IndexSlotChange, FWeaponSlot NewInfo)
+{
+	//dropped or replaced weapon, current one is replaced by InitWeapon
+	if (!SlotWeapons.IsValidIndex(IndexSlotChange))
+		return;
+
+	AWeaponDefault* myWeapon = SlotWeapons[IndexSlotChange];
+	if (!myWeapon || myWeapon->IdWeaponName == NewInfo.NameItem)
+		return;
+	//current weapon is kept if slot got other weapon, InitWeapon will replace it
+	if (myWeapon == CurrentWeapon && !NewInfo.NameItem.IsNone())
+		return;
+
+	SlotWeapons[IndexSlotChange] = nullptr;
+	const bool bWasCurrent = myWeapon == CurrentWeapon;
+	if (bWasCurrent)
+		CurrentWeapon = nullptr;
+	myWeapon->Destroy();
+
+	//slot of current weapon is empty now, take first weapon left in inventory
+	if (bWasCurrent && CharacterInventoryComponent)
+	{
+		const TArray<FWeaponSlot>& mySlots = CharacterInventoryComponent->WeaponSlots;
+		for (int32 i = 0; i < mySlots.Num(); i++)
 		{
-			UE_LOG(LogTemp, Warning, TEXT("ATPSCharacter::InitWeapon - Weapon not found in table - NULL"));
+			if (!mySlots[i].NameItem.IsNone())
+			{
+				InitWeapon(mySlots[i].NameItem, mySlots[i].AdditionalInfo, i);
+				break;
+			}
 		}
 	}
 }
@@ -634,10 +784,10 @@ void ATPSCharacter::TryAbilityEnabled()
 {
 	if (AbilityEffect)//TODO Cool down
 	{
-		UTPS_StateEffect* NewEffect = NewObject<UTPS_StateEffect>(this, AbilityEffect);
-		if (NewEffect)
+		UTPSStateEffectSubsystem* myStateEffects = GetWorld()->GetSubsystem<UTPSStateEffectSubsystem>();
+		if (myStateEffects)
 		{
-			NewEffect->InitObject(this, NAME_None);
+			myStateEffects->ApplyEffect(AbilityEffect, this, NAME_None);
 		}
 	}
 }
@@ -669,13 +819,26 @@ TArray<UTPS_StateEffect*> ATPSCharacter::GetAllCurrentEffects()
 
 void ATPSCharacter::RemoveEffect(UTPS_StateEffect* RemoveEffect)
 {
-	Effects.Remove(RemoveEffect);
-
+	//stacked effects of one class share same archetype pointer, only one entry is removed
+	if (Effects.RemoveSingle(RemoveEffect) > 0 && RemoveEffect)
+	{
+		int32* EffectNum = EffectNumByClass.Find(RemoveEffect->GetClass());
+		if (EffectNum && --(*EffectNum) <= 0)
+			EffectNumByClass.Remove(RemoveEffect->GetClass());
+	}
 }
 
 void ATPSCharacter::AddEffect(UTPS_StateEffect* newEffect)
 {
 	Effects.Add(newEffect);
+	if (newEffect)
+		EffectNumByClass.FindOrAdd(newEffect->GetClass())++;
+}
+
+int32 ATPSCharacter::GetEffectNumByClass(UClass* EffectClass)
+{
+	const int32* EffectNum = EffectNumByClass.Find(EffectClass);
+	return EffectNum ? *EffectNum : 0;
 }
 
 void ATPSCharacter::SetActorRotationByYaw_OnServer_Implementation(float Yaw)
@@ -710,6 +873,10 @@ void ATPSCharacter::CharDead_BP_Implementation()
 void ATPSCharacter::CharDead()
 {
 	CharacterHealthComponent->UTPSHealthComponent::CharIsDead = true;
+	if (CharacterHitProxyComponent)
+	{
+		CharacterHitProxyComponent->SetProxiesEnabled(false);
+	}
 
 	float TimeAnim = 0.0f;
 	int32 rnd = FMath::RandHelper(DeadsAnim.Num());
@@ -759,9 +926,10 @@ float ATPSCharacter::TakeDamage(float DamageAmount, struct FDamageEvent const& D
 	if (DamageEvent.IsOfType(FRadialDamageEvent::ClassID))
 	{
 		AProjectileDefault* myProjectile = Cast<AProjectileDefault>(DamageCauser);
-		if (myProjectile)
+		const FTPSProjectileArchetype* myArchetype = myProjectile ? myProjectile->GetArchetype() : nullptr;
+		if (myArchetype)
 		{
-			UTypes::AddEffectBySurfaceType(this, NAME_None, myProjectile->ProjectileSetting.Effect, GetSurfuceType());
+			UTypes::AddEffectBySurfaceType(this, NAME_None, myArchetype->Info.Effect, GetSurfuceType());
 		}
 	}
 
@@ -8,6 +8,7 @@
 #include "../Weapon/WeaponDefault.h"
 #include "../Character/TPSInventoryComponent.h"
 #include "../Character/TPSCharacterHealthComponent.h"
+#include "../Character/TPSHitProxyComponent.h"
 #include "../Interface/TPS_IGameActor.h"
 #include "../StateEffects/TPS_StateEffect.h"
 
@@ -20,6 +21,7 @@ class ATPSCharacter : public ACharacter, public ITPS_IGameActor
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	//Inputs
 	void InputAxisY(float Value);
@@ -62,12 +64,21 @@ protected:
 
 	//EMovementState MovementState = EMovementState::Run_State;
 
-	UPROPERTY(Replicated)
+	UPROPERTY(ReplicatedUsing = OnRep_CurrentWeapon)
 	AWeaponDefault* CurrentWeapon = nullptr;
+	//holstered weapon is not destroyed, owner must stop local fire prediction on it
+	UFUNCTION()
+	void OnRep_CurrentWeapon(AWeaponDefault* OldWeapon);
+	//weapon actor of every inventory slot on server, not current is hidden and dormant
+	UPROPERTY()
+	TArray<AWeaponDefault*> SlotWeapons;
+	//slot which weapon class is still streaming, INDEX_NONE if nothing wait
+	int32 PendingWeaponIndex = INDEX_NONE;
 
 	UDecalComponent* CurrentCursor = nullptr;
 
 	TArray<UTPS_StateEffect*> Effects;
+	TMap<UClass*, int32> EffectNumByClass;
 
 	int32 CurrentIndexWeapon = 0;
 
@@ -96,6 +107,8 @@ public:
 	class UTPSInventoryComponent* CharacterInventoryComponent;
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Health", meta = (AllowPrivateAccess = "true"))
 	class UTPSCharacterHealthComponent* CharacterHealthComponent;
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Health", meta = (AllowPrivateAccess = "true"))
+	class UTPSHitProxyComponent* CharacterHitProxyComponent;
 
 	//Cursor material on decal
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cursor")
@@ -157,6 +170,10 @@ public:
 
 	UFUNCTION()
 	void InitWeapon(FName IdWeaponName, FAdditionalWeaponInfo WeaponAdditionalInfo, int32 NewCurrentIndexWeapon);
+	AWeaponDefault* SpawnSlotWeapon(FName IdWeaponName, const FWeaponInfo& WeaponInfo);
+	void PendingWeaponAssetsLoaded(FName IdWeaponName, FAdditionalWeaponInfo WeaponAdditionalInfo, int32 NewCurrentIndexWeapon);
+	UFUNCTION()
+	void WeaponSlotUpdated(int32 IndexSlotChange, FWeaponSlot NewInfo);
 	void TryReloadWeapon();
 	UFUNCTION()
 	void WeaponFireStart(UAnimMontage* Anim);
@@ -193,6 +210,7 @@ public:
 	TArray<UTPS_StateEffect*> GetAllCurrentEffects() override;
 	void RemoveEffect(UTPS_StateEffect* RemoveEffect)override;
 	void AddEffect(UTPS_StateEffect* newEffect)override;
+	int32 GetEffectNumByClass(UClass* EffectClass) override;
 	//End Interface
 
 	UFUNCTION(BlueprintNativeEvent)
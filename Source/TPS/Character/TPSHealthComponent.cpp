@@ -2,6 +2,8 @@
 
 
 #include "TPSHealthComponent.h"
+#include "GameFramework/Character.h"
+#include "TPSHitProxyComponent.h"
 
 // Sets default values for this component's properties
 UTPSHealthComponent::UTPSHealthComponent()
@@ -18,8 +20,13 @@ UTPSHealthComponent::UTPSHealthComponent()
 void UTPSHealthComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	// ...
-	
+
+	//enemy blueprints derive from ACharacter and have no hit proxy of their own
+	ACharacter* myCharacter = Cast<ACharacter>(GetOwner());
+	if (myCharacter && !myCharacter->FindComponentByClass<UTPSHitProxyComponent>())
+	{
+		UTPSHitProxyComponent::AddEnemyHitProxy(myCharacter);
+	}
 }
 
 
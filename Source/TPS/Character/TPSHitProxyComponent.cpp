@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSHitProxyComponent.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Character.h"
+#include "Components/SphereComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/BoxComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Materials/MaterialInterface.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "TPSHealthComponent.h"
+#include "../TPS.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Hit Proxy Shapes"), STAT_TPS_HitProxyShapes, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hit Proxy Hits"), STAT_TPS_HitProxyHits, STATGROUP_TPS);
+
+UTPSHitProxyComponent::UTPSHitProxyComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UTPSHitProxyComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	CreateProxies();
+}
+
+void UTPSHitProxyComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (UShapeComponent* Proxy : Proxies)
+	{
+		if (IsValid(Proxy))
+			Proxy->DestroyComponent();
+	}
+	DEC_DWORD_STAT_BY(STAT_TPS_HitProxyShapes, Proxies.Num());
+	Proxies.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTPSHitProxyComponent::CreateProxies()
+{
+	AActor* myOwner = GetOwner();
+	if (!myOwner || Shapes.Num() == 0)
+		return;
+
+	USkeletalMeshComponent* myMesh = myOwner->FindComponentByClass<USkeletalMeshComponent>();
+	USceneComponent* myParent = myMesh ? myMesh : myOwner->GetRootComponent();
+
+	//hit of proxy must give same surface as hit of mesh, else blood and effects are lost
+	UPhysicalMaterial* myPhysMaterial = PhysMaterial;
+	if (!myPhysMaterial && myMesh)
+	{
+		UMaterialInterface* myMaterial = myMesh->GetMaterial(0);
+		myPhysMaterial = myMaterial ? myMaterial->GetPhysicalMaterial() : nullptr;
+	}
+
+	for (const FTPSHitProxyShape& Shape : Shapes)
+	{
+		UShapeComponent* Proxy = nullptr;
+		switch (Shape.Shape)
+		{
+		case ETPSHitProxyShape::Sphere:
+		{
+			USphereComponent* mySphere = NewObject<USphereComponent>(myOwner);
+			mySphere->SetSphereRadius(Shape.Extent.X);
+			Proxy = mySphere;
+			break;
+		}
+		case ETPSHitProxyShape::Capsule:
+		{
+			UCapsuleComponent* myCapsule = NewObject<UCapsuleComponent>(myOwner);
+			myCapsule->SetCapsuleSize(Shape.Extent.X, Shape.Extent.Z);
+			Proxy = myCapsule;
+			break;
+		}
+		case ETPSHitProxyShape::Box:
+		{
+			UBoxComponent* myBox = NewObject<UBoxComponent>(myOwner);
+			myBox->SetBoxExtent(Shape.Extent);
+			Proxy = myBox;
+			break;
+		}
+		}
+
+		Proxy->SetCollisionProfileName(TEXT("HitProxy"));
+		Proxy->SetGenerateOverlapEvents(false);
+		Proxy->SetCanEverAffectNavigation(false);
+		if (myPhysMaterial)
+			Proxy->SetPhysMaterialOverride(myPhysMaterial);
+		Proxy->SetupAttachment(myParent, myMesh ? Shape.Bone : NAME_None);
+		Proxy->SetRelativeTransform(Shape.Offset);
+		Proxy->RegisterComponent();
+		Proxies.Add(Proxy);
+	}
+	INC_DWORD_STAT_BY(STAT_TPS_HitProxyShapes, Proxies.Num());
+
+	if (bReplaceMeshCollision)
+	{
+		TInlineComponentArray<USkeletalMeshComponent*> myMeshes(myOwner);
+		for (USkeletalMeshComponent* Mesh : myMeshes)
+		{
+			//ProjectileTrace and Projectile
+			Mesh->SetCollisionResponseToChannel(ECC_GameTraceChannel2, ECollisionResponse::ECR_Ignore);
+			Mesh->SetCollisionResponseToChannel(ECC_GameTraceChannel3, ECollisionResponse::ECR_Ignore);
+		}
+	}
+}
+
+void UTPSHitProxyComponent::SetProxiesEnabled(bool bEnabled)
+{
+	for (UShapeComponent* Proxy : Proxies)
+	{
+		if (IsValid(Proxy))
+			Proxy->SetCollisionEnabled(bEnabled ? ECollisionEnabled::QueryOnly : ECollisionEnabled::NoCollision);
+	}
+}
+
+const FTPSHitProxyShape* UTPSHitProxyComponent::FindShape(const FHitResult& Hit)
+{
+	const UPrimitiveComponent* myComp = Hit.GetComponent();
+	const AActor* myActor = myComp ? myComp->GetOwner() : nullptr;
+	const UTPSHitProxyComponent* myHitProxy = myActor ? myActor->FindComponentByClass<UTPSHitProxyComponent>() : nullptr;
+	if (!myHitProxy)
+		return nullptr;
+
+	const int32 Index = myHitProxy->Proxies.IndexOfByKey(myComp);
+	return myHitProxy->Shapes.IsValidIndex(Index) ? &myHitProxy->Shapes[Index] : nullptr;
+}
+
+float UTPSHitProxyComponent::GetDamageMultiplier(const FHitResult& Hit)
+{
+	const FTPSHitProxyShape* myShape = FindShape(Hit);
+	if (!myShape)
+		return 1.0f;
+
+	INC_DWORD_STAT(STAT_TPS_HitProxyHits);
+	return myShape->DamageMultiplier;
+}
+
+FName UTPSHitProxyComponent::GetHitBoneName(const FHitResult& Hit)
+{
+	const FTPSHitProxyShape* myShape = FindShape(Hit);
+	return myShape ? myShape->Bone : Hit.BoneName;
+}
+
+UTPSHitProxyComponent* UTPSHitProxyComponent::AddEnemyHitProxy(ACharacter* Character)
+{
+	USkeletalMeshComponent* myMesh = Character ? Character->GetMesh() : nullptr;
+	if (!myMesh || myMesh->GetBoneIndex(TEXT("Head")) == INDEX_NONE || myMesh->GetBoneIndex(TEXT("Spine1")) == INDEX_NONE)
+		return nullptr;
+
+	UTPSHitProxyComponent* myHitProxy = NewObject<UTPSHitProxyComponent>(Character, TEXT("HitProxyComponent"));
+
+	//mixamo bones point along Y, capsule Z is turned to it
+	const FRotator AlongBone(0.0f, 0.0f, 90.0f);
+
+	FTPSHitProxyShape HeadShape;
+	HeadShape.Bone = TEXT("Head");
+	HeadShape.Shape = ETPSHitProxyShape::Sphere;
+	HeadShape.Extent = FVector(13.0f);
+	HeadShape.Offset.SetLocation(FVector(0.0f, 10.0f, 2.0f));
+	HeadShape.DamageMultiplier = 2.0f;
+	myHitProxy->Shapes.Add(HeadShape);
+
+	FTPSHitProxyShape BodyShape;
+	BodyShape.Bone = TEXT("Spine1");
+	BodyShape.Extent = FVector(22.0f, 22.0f, 38.0f);
+	BodyShape.Offset = FTransform(AlongBone, FVector(0.0f, 5.0f, 0.0f));
+	myHitProxy->Shapes.Add(BodyShape);
+
+	for (const TCHAR* UpLeg : { TEXT("LeftUpLeg"), TEXT("RightUpLeg") })
+	{
+		if (myMesh->GetBoneIndex(UpLeg) == INDEX_NONE)
+			continue;
+
+		FTPSHitProxyShape LegShape;
+		LegShape.Bone = UpLeg;
+		LegShape.Extent = FVector(11.0f, 11.0f, 24.0f);
+		LegShape.Offset = FTransform(AlongBone, FVector(0.0f, 22.0f, 0.0f));
+		LegShape.DamageMultiplier = 0.75f;
+		myHitProxy->Shapes.Add(LegShape);
+	}
+
+	UTPSHealthComponent* myHealth = Character->FindComponentByClass<UTPSHealthComponent>();
+	if (myHealth)
+		myHealth->OnDead.AddDynamic(myHitProxy, &UTPSHitProxyComponent::OwnerDead);
+
+	//owner is in begin play, registered component begin play at once and make proxies
+	Character->AddInstanceComponent(myHitProxy);
+	myHitProxy->RegisterComponent();
+	return myHitProxy;
+}
+
+void UTPSHitProxyComponent::OwnerDead()
+{
+	SetProxiesEnabled(false);
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TPSHitProxyComponent.generated.h"
+
+class UShapeComponent;
+class UPhysicalMaterial;
+class ACharacter;
+
+UENUM(BlueprintType)
+enum class ETPSHitProxyShape : uint8
+{
+	Sphere UMETA(DisplayName = "Sphere"),
+	Capsule UMETA(DisplayName = "Capsule"),
+	Box UMETA(DisplayName = "Box")
+};
+
+USTRUCT(BlueprintType)
+struct FTPSHitProxyShape
+{
+	GENERATED_BODY()
+
+	//bone or socket of owner skeletal mesh, none - root
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	FName Bone = NAME_None;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	ETPSHitProxyShape Shape = ETPSHitProxyShape::Capsule;
+	//sphere - X radius, capsule - X radius and Z half height, box - half extent
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	FVector Extent = FVector(20.0f, 20.0f, 40.0f);
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	FTransform Offset = FTransform();
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	float DamageMultiplier = 1.0f;
+};
+
+/**
+ * Few simple shapes in HitProxy collision profile, attached to bones of owner mesh. They block ProjectileTrace and
+ * Projectile instead of owner skeletal mesh, so weapon trace against character is some shape tests and not per bone
+ * physics asset. Hit shape give damage multiplier and bone for effects.
+ * ATPSCharacter create it with mannequin shapes. Enemy blueprints derive from ACharacter, their UTPSHealthComponent
+ * add it with shapes for mixamo skeleton of enemy models.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class TPS_API UTPSHitProxyComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTPSHitProxyComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	TArray<FTPSHitProxyShape> Shapes;
+	//surface of hit for decals, fx and state effects, physical material of owner mesh material if none
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	UPhysicalMaterial* PhysMaterial = nullptr;
+	//owner skeletal meshes stop blocking weapon traces and projectiles
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitProxy")
+	bool bReplaceMeshCollision = true;
+
+	UFUNCTION(BlueprintCallable, Category = "HitProxy")
+	void SetProxiesEnabled(bool bEnabled);
+	const TArray<UShapeComponent*>& GetProxies() const { return Proxies; }
+
+	//1 if hit component is not hit proxy
+	UFUNCTION(BlueprintCallable, Category = "HitProxy")
+	static float GetDamageMultiplier(const FHitResult& Hit);
+	//bone of hit proxy or bone of hit
+	UFUNCTION(BlueprintCallable, Category = "HitProxy")
+	static FName GetHitBoneName(const FHitResult& Hit);
+
+	//shapes for mixamo skeleton of enemy models, null if character mesh has other skeleton
+	static UTPSHitProxyComponent* AddEnemyHitProxy(ACharacter* Character);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void CreateProxies();
+	UFUNCTION()
+	void OwnerDead();
+	static const FTPSHitProxyShape* FindShape(const FHitResult& Hit);
+
+	//same index as Shapes
+	UPROPERTY(Transient)
+	TArray<UShapeComponent*> Proxies;
+};
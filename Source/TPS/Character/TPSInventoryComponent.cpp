@@ -31,14 +31,15 @@ void UTPSInventoryComponent::BeginPlay()
 		{
 			if (!WeaponSlots[i].NameItem.IsNone())
 			{
-				FWeaponInfo Info;
-				if (myGI->GetWeaponInfoByName(WeaponSlots[i].NameItem, Info))
-					WeaponSlots[i].AdditionalInfo.Round = Info.MaxRound;
+				const FWeaponInfo* myInfo = myGI->FindWeaponInfo(WeaponSlots[i].NameItem);
+				if (myInfo)
+					WeaponSlots[i].AdditionalInfo.Round = myInfo->MaxRound;
 			}
 		}
 	}
 
 	MaxSlotsWeapon = WeaponSlots.Num();
+	UpdateSlotWeaponAssets();
 
 	if (WeaponSlots.IsValidIndex(0))
 	{
@@ -47,6 +48,44 @@ void UTPSInventoryComponent::BeginPlay()
 	}
 }
 
+void UTPSInventoryComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
+	if (myGI)
+	{
+		for (const FName& NameWeapon : StreamedSlotWeapons)
+		{
+			myGI->ReleaseWeaponAssets(NameWeapon);
+		}
+	}
+	StreamedSlotWeapons.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTPSInventoryComponent::UpdateSlotWeaponAssets()
+{
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
+	if (!myGI)
+		return;
+
+	//request new before release old, weapon which stay in slots is not unloaded
+	TArray<FName> NewStreamedWeapons;
+	for (const FWeaponSlot& Slot : WeaponSlots)
+	{
+		if (!Slot.NameItem.IsNone())
+		{
+			myGI->RequestWeaponAssets(Slot.NameItem);
+			NewStreamedWeapons.Add(Slot.NameItem);
+		}
+	}
+	for (const FName& NameWeapon : StreamedSlotWeapons)
+	{
+		myGI->ReleaseWeaponAssets(NameWeapon);
+	}
+	StreamedSlotWeapons = MoveTemp(NewStreamedWeapons);
+}
+
 
 // Called every frame
 void UTPSInventoryComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -85,14 +124,13 @@ bool UTPSInventoryComponent::SwitchWeaponToIndexByNextPreviosIndex(int32 ChangeT
 				if (myGI)
 				{
 					//check ammoSlots for this weapon
-					FWeaponInfo myInfo;
-					myGI->GetWeaponInfoByName(WeaponSlots[CorrectIndex].NameItem, myInfo);
+					const FWeaponInfo* myInfo = myGI->FindWeaponInfo(WeaponSlots[CorrectIndex].NameItem);
 
 					bool bIsFind = false;
 					int8 j = 0;
-					while (j < AmmoSlots.Num() && !bIsFind)
+					while (myInfo && j < AmmoSlots.Num() && !bIsFind)
 					{
-						if (AmmoSlots[j].WeaponType == myInfo.WeaponType && AmmoSlots[j].Cout > 0)
+						if (AmmoSlots[j].WeaponType == myInfo->WeaponType && AmmoSlots[j].Cout > 0)
 						{
 							//good weapon have ammo start change
 							bIsSuccess = true;
@@ -146,16 +184,14 @@ bool UTPSInventoryComponent::SwitchWeaponToIndexByNextPreviosIndex(int32 ChangeT
 					}
 					else
 					{
-						FWeaponInfo myInfo;
 						UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
-
-						myGI->GetWeaponInfoByName(WeaponSlots[tmpIndex].NameItem, myInfo);
+						const FWeaponInfo* myInfo = myGI ? myGI->FindWeaponInfo(WeaponSlots[tmpIndex].NameItem) : nullptr;
 
 						bool bIsFind = false;
 						int8 j = 0;
-						while (j < AmmoSlots.Num() && !bIsFind)
+						while (myInfo && j < AmmoSlots.Num() && !bIsFind)
 						{
-							if (AmmoSlots[j].WeaponType == myInfo.WeaponType && AmmoSlots[j].Cout > 0)
+							if (AmmoSlots[j].WeaponType == myInfo->WeaponType && AmmoSlots[j].Cout > 0)
 							{
 								//WeaponGood
 								bIsSuccess = true;
@@ -188,16 +224,14 @@ bool UTPSInventoryComponent::SwitchWeaponToIndexByNextPreviosIndex(int32 ChangeT
 							}
 							else
 							{
-								FWeaponInfo myInfo;
 								UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
-
-								myGI->GetWeaponInfoByName(WeaponSlots[Seconditeration].NameItem, myInfo);
+								const FWeaponInfo* myInfo = myGI ? myGI->FindWeaponInfo(WeaponSlots[Seconditeration].NameItem) : nullptr;
 
 								bool bIsFind = false;
 								int8 j = 0;
-								while (j < AmmoSlots.Num() && !bIsFind)
+								while (myInfo && j < AmmoSlots.Num() && !bIsFind)
 								{
-									if (AmmoSlots[j].WeaponType == myInfo.WeaponType && AmmoSlots[j].Cout > 0)
+									if (AmmoSlots[j].WeaponType == myInfo->WeaponType && AmmoSlots[j].Cout > 0)
 									{
 										//WeaponGood
 										bIsSuccess = true;
@@ -225,16 +259,14 @@ bool UTPSInventoryComponent::SwitchWeaponToIndexByNextPreviosIndex(int32 ChangeT
 							}
 							else
 							{
-								FWeaponInfo myInfo;
 								UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
-
-								myGI->GetWeaponInfoByName(WeaponSlots[Seconditeration].NameItem, myInfo);
+								const FWeaponInfo* myInfo = myGI ? myGI->FindWeaponInfo(WeaponSlots[Seconditeration].NameItem) : nullptr;
 
 								bool bIsFind = false;
 								int8 j = 0;
-								while (j < AmmoSlots.Num() && !bIsFind)
+								while (myInfo && j < AmmoSlots.Num() && !bIsFind)
 								{
-									if (AmmoSlots[j].WeaponType == myInfo.WeaponType)
+									if (AmmoSlots[j].WeaponType == myInfo->WeaponType)
 									{
 										if (AmmoSlots[j].Cout > 0)
 										{
@@ -362,15 +394,15 @@ FName UTPSInventoryComponent::GetWeaponNameBySlotIndex(int32 indexSlot)
 bool UTPSInventoryComponent::GetWeaponTypeByIndexSlot(int32 IndexSlot, EWeaponType& WeaponType)
 {
 	bool bIsFind = false;
-	FWeaponInfo OutInfo;
 	WeaponType = EWeaponType::RifleType;
 	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
 	if (myGI)
 	{
 		if (WeaponSlots.IsValidIndex(IndexSlot))
 		{
-			myGI->GetWeaponInfoByName(WeaponSlots[IndexSlot].NameItem, OutInfo);
-			WeaponType = OutInfo.WeaponType;
+			const FWeaponInfo* myInfo = myGI->FindWeaponInfo(WeaponSlots[IndexSlot].NameItem);
+			if (myInfo)
+				WeaponType = myInfo->WeaponType;
 			bIsFind = true;
 		}
 	}
@@ -380,13 +412,13 @@ bool UTPSInventoryComponent::GetWeaponTypeByIndexSlot(int32 IndexSlot, EWeaponTy
 bool UTPSInventoryComponent::GetWeaponTypeByNameWeapon(FName IdWeaponName, EWeaponType& WeaponType)
 {
 	bool bIsFind = false;
-	FWeaponInfo OutInfo;
 	WeaponType = EWeaponType::RifleType;
 	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
 	if (myGI)
 	{
-		myGI->GetWeaponInfoByName(IdWeaponName, OutInfo);
-		WeaponType = OutInfo.WeaponType;
+		const FWeaponInfo* myInfo = myGI->FindWeaponInfo(IdWeaponName);
+		if (myInfo)
+			WeaponType = myInfo->WeaponType;
 		bIsFind = true;
 	}
 	return bIsFind;
@@ -503,6 +535,7 @@ bool UTPSInventoryComponent::SwitchWeaponToInventory(FWeaponSlot NewWeapon, int3
 	if (WeaponSlots.IsValidIndex(IndexSlot) && GetDropItemInfoFromInventory(IndexSlot, DropItemInfo))
 	{
 		WeaponSlots[IndexSlot] = NewWeapon;
+		UpdateSlotWeaponAssets();
 
 		SwitchWeaponToIndexByNextPreviosIndex(CurrentIndexWeaponChar, -1, NewWeapon.AdditionalInfo, true);
 
@@ -520,6 +553,7 @@ bool UTPSInventoryComponent::TryGetWeaponToInventory(FWeaponSlot NewWeapon)
 		if (WeaponSlots.IsValidIndex(indexSlot))
 		{
 			WeaponSlots[indexSlot] = NewWeapon;
+			UpdateSlotWeaponAssets();
 
 			OnUpdateWeaponSlots.Broadcast(indexSlot, NewWeapon);
 			return true;
@@ -548,8 +582,6 @@ void UTPSInventoryComponent::DropWeaponByIndex(int32 ByIndex, FDropItem& DropIte
 
 	if (bIsCanDrop && WeaponSlots.IsValidIndex(ByIndex) && GetDropItemInfoFromInventory(ByIndex, DropItemInfo))
 	{
-		GetDropItemInfoFromInventory(ByIndex, DropItemInfo);
-
 		//switch weapon to valid slot weapon from start weapon slots array
 		bool bIsFindWeapon = false;
 		int8 j = 0;
@@ -565,30 +597,39 @@ void UTPSInventoryComponent::DropWeaponByIndex(int32 ByIndex, FDropItem& DropIte
 		WeaponSlots[ByIndex] = EmtyWeaponSlot;
 		if (GetOwner()->GetClass()->ImplementsInterface(UTPS_IGameActor::StaticClass()))
 		{
+			//pickup is spawned by blueprint in drop event, it can't be given weapon name so it is caught on spawn
+			FDelegateHandle myDropSpawnHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UTPSInventoryComponent::DroppedActorSpawned, DropItemInfo.WeaponInfo.NameItem));
 			ITPS_IGameActor::Execute_DropWeaponToWorld(GetOwner(), DropItemInfo);
+			GetWorld()->RemoveOnActorSpawnedHandler(myDropSpawnHandle);
 		}
+		//after drop, so pickup already hold assets of dropped weapon
+		UpdateSlotWeaponAssets();
 
 		OnUpdateWeaponSlots.Broadcast(ByIndex, EmtyWeaponSlot);
 	}
 }
 
-bool UTPSInventoryComponent::GetDropItemInfoFromInventory(int32 IndexSlot, FDropItem& DropItemInfo)
+void UTPSInventoryComponent::DroppedActorSpawned(AActor* SpawnedActor, FName NameWeapon)
 {
-	bool result = false;
-
-	FName DropItemName = GetWeaponNameBySlotIndex(IndexSlot);
-
 	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
 	if (myGI)
-	{
-		result = myGI->GetDropItemInfoByWeaponName(DropItemName, DropItemInfo);
-		if (WeaponSlots.IsValidIndex(IndexSlot))
-		{
-			DropItemInfo.WeaponInfo.AdditionalInfo = WeaponSlots[IndexSlot].AdditionalInfo;
-		}
-	}
+		myGI->HoldWeaponAssets(SpawnedActor, NameWeapon);
+}
 
-	return result;
+bool UTPSInventoryComponent::GetDropItemInfoFromInventory(int32 IndexSlot, FDropItem& DropItemInfo)
+{
+	if (!WeaponSlots.IsValidIndex(IndexSlot) || WeaponSlots[IndexSlot].NameItem.IsNone())
+		return false;
+
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetWorld()->GetGameInstance());
+	const FDropItem* myDropItem = myGI ? myGI->FindDropItemInfoByWeaponName(WeaponSlots[IndexSlot].NameItem) : nullptr;
+	if (!myDropItem)
+		return false;
+
+	//copy only for drop, it carry rounds of slot
+	DropItemInfo = *myDropItem;
+	DropItemInfo.WeaponInfo.AdditionalInfo = WeaponSlots[IndexSlot].AdditionalInfo;
+	return true;
 }
 
 TArray<FWeaponSlot> UTPSInventoryComponent::GetWeaponSlots()
@@ -608,6 +649,7 @@ void UTPSInventoryComponent::InitInventory_OnServer_Implementation(const TArray<
 	//Find init weaponsSlots and First Init Weapon
 
 	MaxSlotsWeapon = WeaponSlots.Num();
+	UpdateSlotWeaponAssets();
 
 	if (WeaponSlots.IsValidIndex(0))
 	{
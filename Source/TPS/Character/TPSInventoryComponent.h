@@ -61,6 +61,13 @@ public:
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//assets of weapons in slots are streamed before weapon is taken in hands
+	void UpdateSlotWeaponAssets();
+	//actors spawned by drop event, the pickup among them, keep assets of dropped weapon while they live
+	void DroppedActorSpawned(AActor* SpawnedActor, FName NameWeapon);
+	TArray<FName> StreamedSlotWeapons;
 
 public:
 	// Called every frame
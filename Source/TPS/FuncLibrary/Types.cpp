@@ -4,69 +4,158 @@
 #include "Types.h"
 #include "../TPS.h"
 #include "../Interface/TPS_IGameActor.h"
+#include "Kismet/GameplayStatics.h"
+#include "../Weapon/TPSDecalSubsystem.h"
+#include "../StateEffects/TPSStateEffectSubsystem.h"
+#include "../Weapon/ProjectileDefault.h"
+#include "../Weapon/WeaponDefault.h"
 
 
 void UTypes::AddEffectBySurfaceType(AActor* TakeEffectActor, FName NameBoneHit, TSubclassOf<UTPS_StateEffect> AddEffectClass, EPhysicalSurface SurfaceType)
 {
 	if (SurfaceType != EPhysicalSurface::SurfaceType_Default && TakeEffectActor && AddEffectClass)
 	{
-		UTPS_StateEffect* myEffect = Cast<UTPS_StateEffect>(AddEffectClass->GetDefaultObject());
-		if (myEffect)
+		const UTPS_StateEffect* myEffect = GetDefault<UTPS_StateEffect>(AddEffectClass);
+		if (myEffect && myEffect->CanInteractWithSurface(SurfaceType))
 		{
-			bool bIsHavePossibleSurface = false;
-			int8 i = 0;
-			while (i < myEffect->PossibleInteractSurface.Num() && !bIsHavePossibleSurface)
+			bool bIsCanAddEffect = true;
+			if (!myEffect->bIsStakable)
 			{
-				if (myEffect->PossibleInteractSurface[i] == SurfaceType)
+				ITPS_IGameActor* myInterface = Cast<ITPS_IGameActor>(TakeEffectActor);
+				if (myInterface)
 				{
-					bIsHavePossibleSurface = true;
-					bool bIsCanAddEffect = false;
-					if (!myEffect->bIsStakable)
-					{
-						int8 j = 0;
-						TArray<UTPS_StateEffect*> CurrentEffects;
-						ITPS_IGameActor* myInterface = Cast<ITPS_IGameActor>(TakeEffectActor);
-						if (myInterface)
-						{
-							CurrentEffects = myInterface->GetAllCurrentEffects();
-						}
-
-						if (CurrentEffects.Num() > 0)
-						{
-							while (j < CurrentEffects.Num() && !bIsCanAddEffect)
-							{
-								if (CurrentEffects[j]->GetClass() != AddEffectClass)
-								{
-									bIsCanAddEffect = true;
-								}
-								j++;
-							}
-						}
-						else
-						{
-							bIsCanAddEffect = true;
-						}
-
-					}
-					else
-					{
-						bIsCanAddEffect = true;
-					}
-
-					if (bIsCanAddEffect)
-					{
-
-						UTPS_StateEffect* NewEffect = NewObject<UTPS_StateEffect>(TakeEffectActor, AddEffectClass);
-						if (NewEffect)
-						{
-							NewEffect->InitObject(TakeEffectActor, NameBoneHit);
-						}
-					}
-
+					bIsCanAddEffect = myInterface->GetEffectNumByClass(AddEffectClass) == 0;
 				}
-				i++;
+			}
+
+			UTPSStateEffectSubsystem* myStateEffects = TakeEffectActor->GetWorld()->GetSubsystem<UTPSStateEffectSubsystem>();
+			if (bIsCanAddEffect && myStateEffects)
+			{
+				myStateEffects->ApplyEffect(AddEffectClass, TakeEffectActor, NameBoneHit);
 			}
 		}
+	}
+}
+
+void UTypes::SpawnHitEffects(UObject* WorldContextObject, const FTPSProjectileArchetype& Archetype, EPhysicalSurface SurfaceType, UPrimitiveComponent* HitComponent, const FVector& ImpactPoint, const FVector& ImpactNormal)
+{
+	UWorld* myWorld = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	if (!myWorld)
+		return;
+
+	UMaterialInterface* myMaterial = Archetype.GetHitDecal(SurfaceType);
+	UTPSDecalSubsystem* myDecalSubsystem = myWorld->GetSubsystem<UTPSDecalSubsystem>();
+	if (myMaterial && myDecalSubsystem)
+	{
+		myDecalSubsystem->SpawnHitDecal(myMaterial, FVector(20.0f), HitComponent, ImpactPoint, ImpactNormal.Rotation(), SurfaceType, 0.0f);
+	}
+
+	UParticleSystem* myParticle = Archetype.GetHitFX(SurfaceType);
+	if (myParticle)
+	{
+		UGameplayStatics::SpawnEmitterAtLocation(WorldContextObject, myParticle, FTransform(ImpactNormal.Rotation(), ImpactPoint, FVector(1.0f)));
+	}
+
+	USoundBase* mySound = Archetype.GetHitSound();
+	if (mySound)
+	{
+		UGameplayStatics::PlaySoundAtLocation(WorldContextObject, mySound, ImpactPoint);
+	}
+}
+
+TSubclassOf<AProjectileDefault> UTypes::GetProjectileClass(const FProjectileInfo& ProjectileInfo)
+{
+	return ProjectileInfo.Projectile.Get();
+}
+
+void UTypes::GetProjectileAssets(const FProjectileInfo& ProjectileInfo, UStaticMesh*& ProjectileStaticMesh, UParticleSystem*& ProjectileTrailFx, UStaticMesh*& TracerMesh, USoundBase*& HitSound, UParticleSystem*& ExploseFX, USoundBase*& ExploseSound)
+{
+	ProjectileStaticMesh = ProjectileInfo.ProjectileStaticMesh.Get();
+	ProjectileTrailFx = ProjectileInfo.ProjectileTrailFx.Get();
+	TracerMesh = ProjectileInfo.TracerMesh.Get();
+	HitSound = ProjectileInfo.HitSound.Get();
+	ExploseFX = ProjectileInfo.ExploseFX.Get();
+	ExploseSound = ProjectileInfo.ExploseSound.Get();
+}
 
+void UTypes::GetProjectileHitAssets(const FProjectileInfo& ProjectileInfo, EPhysicalSurface SurfaceType, UMaterialInterface*& HitDecal, UParticleSystem*& HitFX)
+{
+	const TSoftObjectPtr<UMaterialInterface>* myHitDecal = ProjectileInfo.HitDecals.Find(SurfaceType);
+	HitDecal = myHitDecal ? myHitDecal->Get() : nullptr;
+	const TSoftObjectPtr<UParticleSystem>* myHitFX = ProjectileInfo.HitFXs.Find(SurfaceType);
+	HitFX = myHitFX ? myHitFX->Get() : nullptr;
+}
+
+TSubclassOf<AWeaponDefault> UTypes::GetWeaponClass(const FWeaponInfo& WeaponInfo)
+{
+	return WeaponInfo.WeaponClass.Get();
+}
+
+void UTypes::GetWeaponAssets(const FWeaponInfo& WeaponInfo, USoundBase*& SoundFireWeapon, USoundBase*& SoundReloadWeapon, UParticleSystem*& EffectFireWeapon)
+{
+	SoundFireWeapon = WeaponInfo.SoundFireWeapon.Get();
+	SoundReloadWeapon = WeaponInfo.SoundReloadWeapon.Get();
+	EffectFireWeapon = WeaponInfo.EffectFireWeapon.Get();
+}
+
+void UTypes::GetWeaponAnimations(const FAnimationWeaponInfo& AnimationInfo, UAnimMontage*& AnimCharFire, UAnimMontage*& AnimCharFireAim, UAnimMontage*& AnimCharReload, UAnimMontage*& AnimCharReloadAim, UAnimMontage*& AnimWeaponReload, UAnimMontage*& AnimWeaponReloadAim, UAnimMontage*& AnimWeaponFire)
+{
+	AnimCharFire = AnimationInfo.AnimCharFire.Get();
+	AnimCharFireAim = AnimationInfo.AnimCharFireAim.Get();
+	AnimCharReload = AnimationInfo.AnimCharReload.Get();
+	AnimCharReloadAim = AnimationInfo.AnimCharReloadAim.Get();
+	AnimWeaponReload = AnimationInfo.AnimWeaponReload.Get();
+	AnimWeaponReloadAim = AnimationInfo.AnimWeaponReloadAim.Get();
+	AnimWeaponFire = AnimationInfo.AnimWeaponFire.Get();
+}
+
+UStaticMesh* UTypes::GetDropMesh(const FDropMeshInfo& DropMeshInfo)
+{
+	return DropMeshInfo.DropMesh.Get();
+}
+
+static void AddAssetToStream(TArray<FSoftObjectPath>& OutAssets, const FSoftObjectPath& Path)
+{
+	if (Path.IsValid())
+		OutAssets.AddUnique(Path);
+}
+
+//not loaded asset is skipped by fx code, so all of them must be in list
+void FProjectileInfo::GetAssetsToStream(TArray<FSoftObjectPath>& OutAssets) const
+{
+	AddAssetToStream(OutAssets, Projectile.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, ProjectileStaticMesh.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, ProjectileTrailFx.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, TracerMesh.ToSoftObjectPath());
+	for (const TPair<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UMaterialInterface>>& HitDecal : HitDecals)
+	{
+		AddAssetToStream(OutAssets, HitDecal.Value.ToSoftObjectPath());
+	}
+	AddAssetToStream(OutAssets, HitSound.ToSoftObjectPath());
+	for (const TPair<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UParticleSystem>>& HitFX : HitFXs)
+	{
+		AddAssetToStream(OutAssets, HitFX.Value.ToSoftObjectPath());
 	}
-}
\ No newline at end of file
+	AddAssetToStream(OutAssets, ExploseFX.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, ExploseSound.ToSoftObjectPath());
+}
+
+void FWeaponInfo::GetAssetsToStream(TArray<FSoftObjectPath>& OutAssets) const
+{
+	AddAssetToStream(OutAssets, WeaponClass.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, SoundFireWeapon.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, SoundReloadWeapon.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, EffectFireWeapon.ToSoftObjectPath());
+	ProjectileSetting.GetAssetsToStream(OutAssets);
+
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimCharFire.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimCharFireAim.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimCharReload.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimCharReloadAim.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimWeaponReload.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimWeaponReloadAim.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, AnimWeaponInfo.AnimWeaponFire.ToSoftObjectPath());
+
+	AddAssetToStream(OutAssets, ClipDropMesh.DropMesh.ToSoftObjectPath());
+	AddAssetToStream(OutAssets, ShellBullets.DropMesh.ToSoftObjectPath());
+}
@@ -29,6 +29,13 @@ enum class EWeaponType : uint8
 	//RocketLauncher UMETA(DisplayName = "RocketLauncher")
 };
 
+UENUM(BlueprintType)
+enum class EProjectileSimulation : uint8
+{
+	Actor UMETA(DisplayName = "Actor"),
+	Virtual UMETA(DisplayName = "Virtual")
+};
+
 USTRUCT(BlueprintType)
 struct FChatacterSpeed
 {
@@ -55,15 +62,20 @@ struct FProjectileInfo
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
-	TSubclassOf<class AProjectileDefault> Projectile = nullptr;
+	TSoftClassPtr<class AProjectileDefault> Projectile;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
-	UStaticMesh* ProjectileStaticMesh = nullptr;
+	TSoftObjectPtr<UStaticMesh> ProjectileStaticMesh;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
 	FTransform ProjectileStaticMeshOffset = FTransform();
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
-	UParticleSystem* ProjectileTrailFx = nullptr;
+	TSoftObjectPtr<UParticleSystem> ProjectileTrailFx;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
 	FTransform ProjectileTrailFxOffset = FTransform();
+	//mesh along X stretched behind projectile, drawn instanced instead of ProjectileTrailFx when set
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
+	TSoftObjectPtr<UStaticMesh> TracerMesh;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
+	float TracerLength = 300.0f;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
 	float ProjectileDamage = 20.0f;
@@ -74,24 +86,29 @@ struct FProjectileInfo
 	float ProjectileInitSpeed = 2000.0f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
 	float ProjectileMaxSpeed = 2000.0f;
+	//Virtual - no actor, bullet simulated by UTPSVirtualBulletSubsystem, for fast not explosive projectile
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting")
+	EProjectileSimulation Simulation = EProjectileSimulation::Actor;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ProjectileSetting", meta = (EditCondition = "Simulation == EProjectileSimulation::Virtual"))
+	float VirtualGravityScale = 0.0f;
 
 	//material to decal on hit
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FX")
-	TMap<TEnumAsByte<EPhysicalSurface>, UMaterialInterface*> HitDecals;
+	TMap<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UMaterialInterface>> HitDecals;
 	//Sound when hit
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FX")
-	USoundBase* HitSound = nullptr;
+	TSoftObjectPtr<USoundBase> HitSound;
 	//fx when hit check by surface
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FX")
-	TMap<TEnumAsByte<EPhysicalSurface>, UParticleSystem*> HitFXs;
+	TMap<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UParticleSystem>> HitFXs;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effect")
 	TSubclassOf<UTPS_StateEffect> Effect = nullptr;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Explode")
-	UParticleSystem* ExploseFX = nullptr;
+	TSoftObjectPtr<UParticleSystem> ExploseFX;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Explode")
-	USoundBase* ExploseSound = nullptr;
+	TSoftObjectPtr<USoundBase> ExploseSound;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Explode")
 	float ProjectileMaxRadiusDamage = 200.0f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Explode")
@@ -101,6 +118,9 @@ struct FProjectileInfo
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Explode")
 	float ExplodeFalloffCoef = 1.0f;
 	//Timer add
+
+	//soft assets to stream before projectile is used
+	void GetAssetsToStream(TArray<FSoftObjectPath>& OutAssets) const;
 };
 
 USTRUCT(BlueprintType)
@@ -151,20 +171,20 @@ struct FAnimationWeaponInfo
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimCharFire = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimCharFire;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimCharFireAim = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimCharFireAim;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimCharReload = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimCharReload;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimCharReloadAim = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimCharReloadAim;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimWeaponReload = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimWeaponReload;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimWeaponReloadAim = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimWeaponReloadAim;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Anim Char")
-	UAnimMontage* AnimWeaponFire = nullptr;
+	TSoftObjectPtr<UAnimMontage> AnimWeaponFire;
 };
 
 USTRUCT(BlueprintType)
@@ -173,7 +193,7 @@ struct FDropMeshInfo
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DporMesh")
-	UStaticMesh* DropMesh = nullptr;
+	TSoftObjectPtr<UStaticMesh> DropMesh;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DporMesh")
 	float DropMeshTime = -1.0f;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DporMesh")
@@ -196,7 +216,7 @@ struct FWeaponInfo : public FTableRowBase
 	GENERATED_BODY()
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Class")
-	TSubclassOf<class AWeaponDefault> WeaponClass = nullptr;
+	TSoftClassPtr<class AWeaponDefault> WeaponClass;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "State")
 	float RateOfFire = 0.5f;
@@ -211,16 +231,19 @@ struct FWeaponInfo : public FTableRowBase
 	FWeaponDispersion DispersionWeapon;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sound ")
-	USoundBase* SoundFireWeapon = nullptr;
+	TSoftObjectPtr<USoundBase> SoundFireWeapon;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sound ")
-	USoundBase* SoundReloadWeapon = nullptr;
+	TSoftObjectPtr<USoundBase> SoundReloadWeapon;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FX ")
-	UParticleSystem* EffectFireWeapon = nullptr;
-	//if null use trace logic (TSubclassOf<class AProjectileDefault> Projectile = nullptr), use projectile setting damage, FX and other for trace logic
+	TSoftObjectPtr<UParticleSystem> EffectFireWeapon;
+	//if null use trace logic (TSoftClassPtr<class AProjectileDefault> Projectile = nullptr), use projectile setting damage, FX and other for trace logic
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile ")
 	FProjectileInfo ProjectileSetting;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trace ")
 	float DistacneTrace = 2000.0f;
+	//trace pellets by async scene query, hits applied on next frame
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Trace ")
+	bool bAsyncTrace = true;
 	//one decal on all?
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HitEffect ")
 	UDecalComponent* DecalOnHit = nullptr;
@@ -241,6 +264,9 @@ struct FWeaponInfo : public FTableRowBase
 	UTexture2D* WeaponIcon = nullptr;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Inventory ")
 	EWeaponType WeaponType = EWeaponType::RifleType;
+
+	//class, meshes, fx, sounds and montages are soft, streamed by UTPSGameInstance::RequestWeaponAssets
+	void GetAssetsToStream(TArray<FSoftObjectPath>& OutAssets) const;
 };
 
 USTRUCT(BlueprintType)
@@ -294,6 +320,69 @@ struct FDropItem : public FTableRowBase
 	FWeaponSlot WeaponInfo;
 };
 
+//one trace hit of shot, send to clients by weapon
+USTRUCT()
+struct FTPSShotImpact
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize ImpactPoint = FVector::ZeroVector;
+	UPROPERTY()
+	FVector_NetQuantizeNormal ImpactNormal = FVector::ZeroVector;
+	UPROPERTY()
+	uint8 SurfaceType = 0;
+	//for attach decal, can be null on client if component is not net addressable
+	UPROPERTY()
+	UPrimitiveComponent* HitComponent = nullptr;
+};
+
+//projectiles of one server shot, clients spawn local cosmetic projectiles by it
+USTRUCT()
+struct FTPSProjectileShot
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector_NetQuantize10 Origin = FVector::ZeroVector;
+	UPROPERTY()
+	TArray<FVector_NetQuantizeNormal> Directions;
+	UPROPERTY()
+	float Speed = 0.0f;
+	//server world time of shot, client move projectiles forward by time passed
+	UPROPERTY()
+	float ServerTime = 0.0f;
+};
+
+//projectile setting of one weapon, made once by UTPSProjectileArchetypeSubsystem and not changed after.
+//Assets are not referenced by archetype, getters resolve loaded ones so weapon asset release can unload them.
+//Surface maps are flat arrays by surface type byte
+USTRUCT()
+struct FTPSProjectileArchetype
+{
+	GENERATED_BODY()
+
+	//damage, speed, radius and other values
+	UPROPERTY()
+	FProjectileInfo Info;
+
+	TSoftObjectPtr<UMaterialInterface> HitDecals[SurfaceType_Max];
+	TSoftObjectPtr<UParticleSystem> HitFXs[SurfaceType_Max];
+
+	//null while assets are not streamed
+	UStaticMesh* GetStaticMesh() const { return Info.ProjectileStaticMesh.Get(); }
+	UParticleSystem* GetTrailFx() const { return Info.ProjectileTrailFx.Get(); }
+	UStaticMesh* GetTracerMesh() const { return Info.TracerMesh.Get(); }
+	USoundBase* GetHitSound() const { return Info.HitSound.Get(); }
+	UParticleSystem* GetExploseFX() const { return Info.ExploseFX.Get(); }
+	USoundBase* GetExploseSound() const { return Info.ExploseSound.Get(); }
+	UMaterialInterface* GetHitDecal(EPhysicalSurface SurfaceType) const { return SurfaceType < SurfaceType_Max ? HitDecals[SurfaceType].Get() : nullptr; }
+	UParticleSystem* GetHitFX(EPhysicalSurface SurfaceType) const { return SurfaceType < SurfaceType_Max ? HitFXs[SurfaceType].Get() : nullptr; }
+};
+
+class AProjectileDefault;
+class AWeaponDefault;
+
 UCLASS()
 class TPS_API UTypes : public UBlueprintFunctionLibrary
 {
@@ -303,4 +392,24 @@ public:
 
 	UFUNCTION(BlueprintCallable)
 	static void AddEffectBySurfaceType(AActor* TakeEffectActor, FName NameBoneHit, TSubclassOf<UTPS_StateEffect> AddEffectClass, EPhysicalSurface SurfaceType);
+
+	//assets of soft fields which are already resident, null while weapon assets are not streamed, never load
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+	static TSubclassOf<AProjectileDefault> GetProjectileClass(const FProjectileInfo& ProjectileInfo);
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+	static void GetProjectileAssets(const FProjectileInfo& ProjectileInfo, UStaticMesh*& ProjectileStaticMesh, UParticleSystem*& ProjectileTrailFx, UStaticMesh*& TracerMesh, USoundBase*& HitSound, UParticleSystem*& ExploseFX, USoundBase*& ExploseSound);
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+	static void GetProjectileHitAssets(const FProjectileInfo& ProjectileInfo, EPhysicalSurface SurfaceType, UMaterialInterface*& HitDecal, UParticleSystem*& HitFX);
+
+	UFUNCTION(BlueprintPure, Category = "Weapon")
+	static TSubclassOf<AWeaponDefault> GetWeaponClass(const FWeaponInfo& WeaponInfo);
+	UFUNCTION(BlueprintPure, Category = "Weapon")
+	static void GetWeaponAssets(const FWeaponInfo& WeaponInfo, USoundBase*& SoundFireWeapon, USoundBase*& SoundReloadWeapon, UParticleSystem*& EffectFireWeapon);
+	UFUNCTION(BlueprintPure, Category = "Weapon")
+	static void GetWeaponAnimations(const FAnimationWeaponInfo& AnimationInfo, UAnimMontage*& AnimCharFire, UAnimMontage*& AnimCharFireAim, UAnimMontage*& AnimCharReload, UAnimMontage*& AnimCharReloadAim, UAnimMontage*& AnimWeaponReload, UAnimMontage*& AnimWeaponReloadAim, UAnimMontage*& AnimWeaponFire);
+	UFUNCTION(BlueprintPure, Category = "Weapon")
+	static UStaticMesh* GetDropMesh(const FDropMeshInfo& DropMeshInfo);
+
+	//decal, fx and sound of projectile hit by surface, only cosmetic
+	static void SpawnHitEffects(UObject* WorldContextObject, const FTPSProjectileArchetype& Archetype, EPhysicalSurface SurfaceType, UPrimitiveComponent* HitComponent, const FVector& ImpactPoint, const FVector& ImpactNormal);
 };
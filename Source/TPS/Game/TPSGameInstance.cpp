@@ -2,22 +2,83 @@
 
 
 #include "TPSGameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "../TPS.h"
+
+void UTPSGameInstance::Init()
+{
+	Super::Init();
+
+	BuildWeaponRegistry();
+	BuildDropItemIndex();
+}
+
+void UTPSGameInstance::BuildWeaponRegistry()
+{
+	WeaponDefinitions.Reset();
+	WeaponNames.Reset();
+	WeaponIdByName.Reset();
+
+	if (!WeaponInfoTable)
+	{
+		UE_LOG(LogTPS, Warning, TEXT("UTPSGameInstance::BuildWeaponRegistry - WeaponTable -NULL"));
+		return;
+	}
+
+	const TMap<FName, uint8*>& RowMap = WeaponInfoTable->GetRowMap();
+	WeaponDefinitions.Reserve(RowMap.Num());
+	WeaponNames.Reserve(RowMap.Num());
+	WeaponIdByName.Reserve(RowMap.Num());
+
+	for (const TPair<FName, uint8*>& Row : RowMap)
+	{
+		const int32 WeaponId = WeaponDefinitions.Add(*reinterpret_cast<const FWeaponInfo*>(Row.Value));
+		WeaponNames.Add(Row.Key);
+		WeaponIdByName.Add(Row.Key, WeaponId);
+	}
+}
+
+int32 UTPSGameInstance::GetWeaponId(FName NameWeapon) const
+{
+	const int32* WeaponId = WeaponIdByName.Find(NameWeapon);
+	return WeaponId ? *WeaponId : INDEX_NONE;
+}
+
+FName UTPSGameInstance::GetWeaponNameById(int32 WeaponId) const
+{
+	return WeaponNames.IsValidIndex(WeaponId) ? WeaponNames[WeaponId] : NAME_None;
+}
+
+const FWeaponInfo* UTPSGameInstance::GetWeaponInfoById(int32 WeaponId) const
+{
+	return WeaponDefinitions.IsValidIndex(WeaponId) ? &WeaponDefinitions[WeaponId] : nullptr;
+}
+
+const FWeaponInfo* UTPSGameInstance::FindWeaponInfo(FName NameWeapon) const
+{
+	return GetWeaponInfoById(GetWeaponId(NameWeapon));
+}
+
+SIZE_T UTPSGameInstance::GetWeaponRegistryAllocatedSize() const
+{
+	return WeaponDefinitions.GetAllocatedSize() + WeaponNames.GetAllocatedSize() + WeaponIdByName.GetAllocatedSize();
+}
 
 bool UTPSGameInstance::GetWeaponInfoByName(FName NameWeapon, FWeaponInfo& OutInfo)
 {
 	bool bIsFind = false;
-	FWeaponInfo* WeaponInfoRow;
 
-	if (WeaponInfoTable)
+	const FWeaponInfo* WeaponInfo = FindWeaponInfo(NameWeapon);
+	if (WeaponInfo)
 	{
-		WeaponInfoRow = WeaponInfoTable->FindRow<FWeaponInfo>(NameWeapon, "", false);
-		if (WeaponInfoRow)
-		{
-			bIsFind = true;
-			OutInfo = *WeaponInfoRow;
-		}
+		bIsFind = true;
+		OutInfo = *WeaponInfo;
 	}
-	else
+	else if (!WeaponInfoTable)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("UTPSGameInstance::GetWeaponInfoByName - WeaponTable -NULL"));
 	}
@@ -29,24 +90,13 @@ bool UTPSGameInstance::GetDropItemInfoByWeaponName(FName NameItem, FDropItem& Ou
 {
 	bool bIsFind = false;
 
-	if (DropItemInfoTable)
+	const FDropItem* DropItemInfoRow = FindDropItemInfoByWeaponName(NameItem);
+	if (DropItemInfoRow)
 	{
-		FDropItem* DropItemInfoRow;
-		TArray<FName>RowNames = DropItemInfoTable->GetRowNames();
-
-		int8 i = 0;
-		while (i < RowNames.Num() && !bIsFind)
-		{
-			DropItemInfoRow = DropItemInfoTable->FindRow<FDropItem>(RowNames[i], "");
-			if (DropItemInfoRow->WeaponInfo.NameItem == NameItem)
-			{
-				OutInfo = (*DropItemInfoRow);
-				bIsFind = true;
-			}
-			i++;//fix
-		}
+		OutInfo = *DropItemInfoRow;
+		bIsFind = true;
 	}
-	else
+	else if (!DropItemInfoTable)
 	{
 		UE_LOG(LogTemp, Warning, TEXT("UTPSGameInstance::GetDropItemInfoByName - DropItemInfoTable -NULL"));
 	}
@@ -54,6 +104,183 @@ bool UTPSGameInstance::GetDropItemInfoByWeaponName(FName NameItem, FDropItem& Ou
 	return bIsFind;
 }
 
+const FDropItem* UTPSGameInstance::FindDropItemInfoByWeaponName(FName NameItem)
+{
+	//table is BlueprintReadWrite, can be replaced at runtime
+	if (IndexedDropItemTable != DropItemInfoTable)
+		BuildDropItemIndex();
+
+	const FDropItem* const* DropItemInfoRow = DropItemByWeaponName.Find(NameItem);
+	return DropItemInfoRow ? *DropItemInfoRow : nullptr;
+}
+
+void UTPSGameInstance::BuildDropItemIndex()
+{
+#if WITH_EDITOR
+	if (IndexedDropItemTable)
+		IndexedDropItemTable->OnDataTableChanged().Remove(DropItemTableChangedHandle);
+	DropItemTableChangedHandle.Reset();
+#endif
+
+	DropItemByWeaponName.Reset();
+	IndexedDropItemTable = DropItemInfoTable;
+	if (!DropItemInfoTable)
+		return;
+
+#if WITH_EDITOR
+	DropItemTableChangedHandle = DropItemInfoTable->OnDataTableChanged().AddUObject(this, &UTPSGameInstance::OnDropItemTableChanged);
+#endif
+
+	const TMap<FName, uint8*>& RowMap = DropItemInfoTable->GetRowMap();
+	DropItemByWeaponName.Reserve(RowMap.Num());
+	for (const TPair<FName, uint8*>& Row : RowMap)
+	{
+		const FDropItem* DropItemInfoRow = reinterpret_cast<const FDropItem*>(Row.Value);
+		//first row wins as in old linear search
+		if (!DropItemByWeaponName.Contains(DropItemInfoRow->WeaponInfo.NameItem))
+			DropItemByWeaponName.Add(DropItemInfoRow->WeaponInfo.NameItem, DropItemInfoRow);
+	}
+}
+
+void UTPSGameInstance::OnDropItemTableChanged()
+{
+	//row memory can be reallocated on change, pointers in index are not valid anymore
+	BuildDropItemIndex();
+}
+
+void UTPSGameInstance::RequestWeaponAssets(FName NameWeapon)
+{
+	const FWeaponInfo* WeaponInfo = FindWeaponInfo(NameWeapon);
+	if (!WeaponInfo)
+		return;
+
+	FWeaponAssetsRequest& Request = WeaponAssetsRequests.FindOrAdd(NameWeapon);
+	Request.Users++;
+	if (Request.Handle.IsValid())
+		return;
+
+	TArray<FSoftObjectPath> Assets;
+	WeaponInfo->GetAssetsToStream(Assets);
+	//weapon without soft assets have nothing to wait
+	if (Assets.Num() > 0)
+	{
+		Request.Handle = WeaponStreamable.RequestAsyncLoad(Assets, FStreamableDelegate::CreateUObject(this, &UTPSGameInstance::OnWeaponAssetsLoaded, NameWeapon), FStreamableManager::AsyncLoadHighPriority);
+	}
+}
+
+void UTPSGameInstance::ReleaseWeaponAssets(FName NameWeapon)
+{
+	FWeaponAssetsRequest* Request = WeaponAssetsRequests.Find(NameWeapon);
+	if (!Request || --Request->Users > 0)
+		return;
+
+	//assets stay in memory until GC if nobody else reference them
+	if (Request->Handle.IsValid())
+	{
+		if (Request->Handle->IsLoadingInProgress())
+			Request->Handle->CancelHandle();
+		else
+			Request->Handle->ReleaseHandle();
+	}
+	WeaponAssetsRequests.Remove(NameWeapon);
+}
+
+void UTPSGameInstance::HoldWeaponAssets(AActor* Holder, FName NameWeapon)
+{
+	if (!Holder || NameWeapon.IsNone() || !FindWeaponInfo(NameWeapon))
+		return;
+
+	RequestWeaponAssets(NameWeapon);
+	WeaponAssetsHolders.FindOrAdd(Holder).Add(NameWeapon);
+	Holder->OnEndPlay.AddUniqueDynamic(this, &UTPSGameInstance::WeaponAssetsHolderEndPlay);
+}
+
+void UTPSGameInstance::WeaponAssetsHolderEndPlay(AActor* Holder, EEndPlayReason::Type EndPlayReason)
+{
+	TArray<FName> myWeapons;
+	if (!WeaponAssetsHolders.RemoveAndCopyValue(Holder, myWeapons))
+		return;
+
+	for (const FName& NameWeapon : myWeapons)
+	{
+		ReleaseWeaponAssets(NameWeapon);
+	}
+}
+
+bool UTPSGameInstance::IsWeaponAssetsLoaded(FName NameWeapon) const
+{
+	const FWeaponAssetsRequest* Request = WeaponAssetsRequests.Find(NameWeapon);
+	return Request && (!Request->Handle.IsValid() || Request->Handle->HasLoadCompleted());
+}
+
+void UTPSGameInstance::CallWhenWeaponAssetsLoaded(FName NameWeapon, FStreamableDelegate OnLoaded)
+{
+	FWeaponAssetsRequest* Request = WeaponAssetsRequests.Find(NameWeapon);
+	if (Request && Request->Handle.IsValid() && Request->Handle->IsLoadingInProgress())
+	{
+		Request->OnLoaded.Add(MoveTemp(OnLoaded));
+	}
+	else
+	{
+		OnLoaded.ExecuteIfBound();
+	}
+}
+
+void UTPSGameInstance::OnWeaponAssetsLoaded(FName NameWeapon)
+{
+	FWeaponAssetsRequest* Request = WeaponAssetsRequests.Find(NameWeapon);
+	if (!Request)
+		return;
+
+	//delegate can request or release weapons, map can be changed
+	TArray<FStreamableDelegate> OnLoaded = MoveTemp(Request->OnLoaded);
+	Request->OnLoaded.Reset();
+	for (FStreamableDelegate& Delegate : OnLoaded)
+	{
+		Delegate.ExecuteIfBound();
+	}
+}
+
+int32 UTPSGameInstance::GetWeaponAssetsUsers(FName NameWeapon) const
+{
+	const FWeaponAssetsRequest* Request = WeaponAssetsRequests.Find(NameWeapon);
+	return Request ? Request->Users : 0;
+}
+
+void UTPSGameInstance::GetWeaponAssetsMemory(FName NameWeapon, int32& OutAssetsNum, int32& OutLoadedNum, int64& OutResidentBytes, int64& OutNotLoadedBytes) const
+{
+	OutAssetsNum = 0;
+	OutLoadedNum = 0;
+	OutResidentBytes = 0;
+	OutNotLoadedBytes = 0;
+
+	const FWeaponInfo* WeaponInfo = FindWeaponInfo(NameWeapon);
+	if (!WeaponInfo)
+		return;
+
+	TArray<FSoftObjectPath> Assets;
+	WeaponInfo->GetAssetsToStream(Assets);
+	OutAssetsNum = Assets.Num();
+	for (const FSoftObjectPath& Asset : Assets)
+	{
+		UObject* myObject = Asset.ResolveObject();
+		if (myObject)
+		{
+			OutLoadedNum++;
+			OutResidentBytes += myObject->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+			continue;
+		}
+
+		FString PackageFile;
+		if (FPackageName::DoesPackageExist(Asset.GetLongPackageName(), nullptr, &PackageFile))
+		{
+			OutNotLoadedBytes += FMath::Max<int64>(IFileManager::Get().FileSize(*PackageFile), 0);
+			//cooked package keep exports in .uexp
+			OutNotLoadedBytes += FMath::Max<int64>(IFileManager::Get().FileSize(*FPaths::ChangeExtension(PackageFile, TEXT("uexp"))), 0);
+		}
+	}
+}
+
 bool UTPSGameInstance::GetDropItemInfoByName(FName NameItem, FDropItem& OutInfo)
 {
 	bool bIsFind = false;
@@ -75,3 +302,86 @@ bool UTPSGameInstance::GetDropItemInfoByName(FName NameItem, FDropItem& OutInfo)
 
 	return bIsFind;
 }
+
+#if !UE_BUILD_SHIPPING
+//TPS.WeaponRegistry.Benchmark [Iterations] - DataTable row copy against registry lookup for all weapons
+static FAutoConsoleCommandWithWorldAndArgs CmdWeaponRegistryBenchmark(
+	TEXT("TPS.WeaponRegistry.Benchmark"),
+	TEXT("Compare weapon info lookup by DataTable copy and by registry, arg is iterations"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UTPSGameInstance* myGI = World ? World->GetGameInstance<UTPSGameInstance>() : nullptr;
+		if (!myGI || !myGI->WeaponInfoTable || myGI->GetWeaponsNum() == 0)
+		{
+			UE_LOG(LogTPS, Warning, TEXT("TPS.WeaponRegistry.Benchmark - no weapons"));
+			return;
+		}
+
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const TArray<FName> RowNames = myGI->WeaponInfoTable->GetRowNames();
+		int32 Checksum = 0;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			for (const FName& RowName : RowNames)
+			{
+				FWeaponInfo* WeaponInfoRow = myGI->WeaponInfoTable->FindRow<FWeaponInfo>(RowName, "", false);
+				if (WeaponInfoRow)
+				{
+					FWeaponInfo Info = *WeaponInfoRow;
+					Checksum += Info.MaxRound;
+				}
+			}
+		}
+		const double CopyTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			for (const FName& RowName : RowNames)
+			{
+				const FWeaponInfo* Info = myGI->FindWeaponInfo(RowName);
+				if (Info)
+					Checksum += Info->MaxRound;
+			}
+		}
+		const double RegistryTime = FPlatformTime::Seconds() - StartTime;
+
+		const int32 Lookups = Iterations * RowNames.Num();
+		UE_LOG(LogTPS, Log, TEXT("TPS.WeaponRegistry.Benchmark - %d lookups of %d weapons (checksum %d)"), Lookups, RowNames.Num(), Checksum);
+		UE_LOG(LogTPS, Log, TEXT("  DataTable copy: %.3f ms, %.1f ns per lookup, %d bytes copied per lookup (inline part only)"), CopyTime * 1000.0, CopyTime * 1.0e9 / Lookups, (int32)sizeof(FWeaponInfo));
+		UE_LOG(LogTPS, Log, TEXT("  Registry: %.3f ms, %.1f ns per lookup, 0 bytes copied, registry %d bytes"), RegistryTime * 1000.0, RegistryTime * 1.0e9 / Lookups, (int32)myGI->GetWeaponRegistryAllocatedSize());
+	}));
+
+//TPS.WeaponAssets.Report - resident and not loaded memory of soft assets per weapon
+static FAutoConsoleCommandWithWorld CmdWeaponAssetsReport(
+	TEXT("TPS.WeaponAssets.Report"),
+	TEXT("Log loaded assets, resident memory and memory saved by not loaded assets of every weapon"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		UTPSGameInstance* myGI = World ? World->GetGameInstance<UTPSGameInstance>() : nullptr;
+		if (!myGI || myGI->GetWeaponsNum() == 0)
+		{
+			UE_LOG(LogTPS, Warning, TEXT("TPS.WeaponAssets.Report - no weapons"));
+			return;
+		}
+
+		int64 TotalResident = 0;
+		int64 TotalNotLoaded = 0;
+		for (int32 WeaponId = 0; WeaponId < myGI->GetWeaponsNum(); WeaponId++)
+		{
+			const FName NameWeapon = myGI->GetWeaponNameById(WeaponId);
+			int32 AssetsNum, LoadedNum;
+			int64 ResidentBytes, NotLoadedBytes;
+			myGI->GetWeaponAssetsMemory(NameWeapon, AssetsNum, LoadedNum, ResidentBytes, NotLoadedBytes);
+			TotalResident += ResidentBytes;
+			TotalNotLoaded += NotLoadedBytes;
+
+			UE_LOG(LogTPS, Log, TEXT("  %s: users %d, loaded %d/%d assets, resident %.1f KB, saved ~%.1f KB (on disk)"),
+				*NameWeapon.ToString(), myGI->GetWeaponAssetsUsers(NameWeapon), LoadedNum, AssetsNum, ResidentBytes / 1024.0, NotLoadedBytes / 1024.0);
+		}
+		//asset shared by weapons is counted for every one of them
+		UE_LOG(LogTPS, Log, TEXT("TPS.WeaponAssets.Report - %d weapons, resident %.1f KB, saved ~%.1f KB"), myGI->GetWeaponsNum(), TotalResident / 1024.0, TotalNotLoaded / 1024.0);
+	}));
+#endif
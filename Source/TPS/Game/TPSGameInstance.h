@@ -6,6 +6,7 @@
 #include "Engine/GameInstance.h"
 #include "../FuncLibrary/Types.h"
 #include "Engine/DataTable.h"
+#include "Engine/StreamableManager.h"
 #include "../Weapon/WeaponDefault.h"
 #include "TPSGameInstance.generated.h"
 
@@ -19,6 +20,8 @@ class TPS_API UTPSGameInstance : public UGameInstance
 	
  
 public:
+	virtual void Init() override;
+
 	//table
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = " WeaponSetting ")
 	UDataTable* WeaponInfoTable = nullptr;
@@ -26,8 +29,60 @@ public:
 	UDataTable* DropItemInfoTable = nullptr;
 	UFUNCTION(BlueprintCallable)
 	bool GetWeaponInfoByName(FName NameWeapon, FWeaponInfo& OutInfo);
+
+	//weapon registry, rows of WeaponInfoTable copied once on Init, don't change after
+	int32 GetWeaponId(FName NameWeapon) const;
+	FName GetWeaponNameById(int32 WeaponId) const;
+	const FWeaponInfo* GetWeaponInfoById(int32 WeaponId) const;
+	//no copy, null if weapon not found
+	const FWeaponInfo* FindWeaponInfo(FName NameWeapon) const;
+	int32 GetWeaponsNum() const { return WeaponDefinitions.Num(); }
+	SIZE_T GetWeaponRegistryAllocatedSize() const;
 	UFUNCTION(BlueprintCallable)
 	bool GetDropItemInfoByWeaponName(FName NameItem, FDropItem& OutInfo);
 	UFUNCTION(BlueprintCallable)
 	bool GetDropItemInfoByName(FName NameItem, FDropItem& OutInfo);
+	//row of DropItemInfoTable by WeaponInfo.NameItem, no copy, null if not found
+	const FDropItem* FindDropItemInfoByWeaponName(FName NameItem);
+
+	//soft assets of weapon are kept loaded while somebody requested them (weapon actor, inventory slot, pickup), every request need release
+	void RequestWeaponAssets(FName NameWeapon);
+	void ReleaseWeaponAssets(FName NameWeapon);
+	//request released when Holder end play, for pickups spawned by blueprint which don't know weapon assets
+	void HoldWeaponAssets(AActor* Holder, FName NameWeapon);
+	bool IsWeaponAssetsLoaded(FName NameWeapon) const;
+	//call now if loaded, else when streaming is done. Weapon must be requested, delegate is dropped with last release
+	void CallWhenWeaponAssetsLoaded(FName NameWeapon, FStreamableDelegate OnLoaded);
+	int32 GetWeaponAssetsUsers(FName NameWeapon) const;
+	//loaded and not loaded size of weapon assets, not loaded one is estimated by package size on disk
+	void GetWeaponAssetsMemory(FName NameWeapon, int32& OutAssetsNum, int32& OutLoadedNum, int64& OutResidentBytes, int64& OutNotLoadedBytes) const;
+
+protected:
+	void BuildWeaponRegistry();
+
+	//by WeaponId
+	TArray<FWeaponInfo> WeaponDefinitions;
+	TArray<FName> WeaponNames;
+	TMap<FName, int32> WeaponIdByName;
+
+	//reverse index WeaponInfo.NameItem -> row of DropItemInfoTable, rebuilt when table is reassigned or changed in editor
+	void BuildDropItemIndex();
+	void OnDropItemTableChanged();
+	TMap<FName, const FDropItem*> DropItemByWeaponName;
+	UPROPERTY()
+	UDataTable* IndexedDropItemTable = nullptr;
+	FDelegateHandle DropItemTableChangedHandle;
+
+	struct FWeaponAssetsRequest
+	{
+		TSharedPtr<FStreamableHandle> Handle;
+		int32 Users = 0;
+		TArray<FStreamableDelegate> OnLoaded;
+	};
+	void OnWeaponAssetsLoaded(FName NameWeapon);
+	UFUNCTION()
+	void WeaponAssetsHolderEndPlay(AActor* Holder, EEndPlayReason::Type EndPlayReason);
+	TMap<TWeakObjectPtr<AActor>, TArray<FName>> WeaponAssetsHolders;
+	FStreamableManager WeaponStreamable;
+	TMap<FName, FWeaponAssetsRequest> WeaponAssetsRequests;
 };
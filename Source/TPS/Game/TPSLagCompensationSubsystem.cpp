@@ -0,0 +1,355 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSLagCompensationSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerState.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Components/ShapeComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "../Character/TPSHitProxyComponent.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("LagComp Record"), STAT_TPS_LagCompRecord, STATGROUP_TPS);
+DECLARE_CYCLE_STAT(TEXT("LagComp Rewind"), STAT_TPS_LagCompRewind, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LagComp Rewound Characters"), STAT_TPS_LagCompRewoundCharacters, STATGROUP_TPS);
+
+int32 LagCompEnable = 1;
+FAutoConsoleVariableRef CVarLagCompEnable(
+	TEXT("TPS.LagComp.Enable"),
+	LagCompEnable,
+	TEXT("Rewind characters to shooter time for hitscan shots"),
+	ECVF_Default);
+
+float LagCompHistoryTime = 1.0f;
+FAutoConsoleVariableRef CVarLagCompHistoryTime(
+	TEXT("TPS.LagComp.HistoryTime"),
+	LagCompHistoryTime,
+	TEXT("Seconds of character history kept on server, used when world start"),
+	ECVF_Default);
+
+float LagCompRecordRate = 60.0f;
+FAutoConsoleVariableRef CVarLagCompRecordRate(
+	TEXT("TPS.LagComp.RecordRate"),
+	LagCompRecordRate,
+	TEXT("History frames recorded per second, used when world start"),
+	ECVF_Default);
+
+int32 LagCompMaxCharacters = 64;
+FAutoConsoleVariableRef CVarLagCompMaxCharacters(
+	TEXT("TPS.LagComp.MaxCharacters"),
+	LagCompMaxCharacters,
+	TEXT("Max characters recorded, used when world start"),
+	ECVF_Default);
+
+int32 LagCompMaxShapes = 8;
+FAutoConsoleVariableRef CVarLagCompMaxShapes(
+	TEXT("TPS.LagComp.MaxShapes"),
+	LagCompMaxShapes,
+	TEXT("Max hit shapes recorded per character, used when world start"),
+	ECVF_Default);
+
+float LagCompMaxRewind = 0.4f;
+FAutoConsoleVariableRef CVarLagCompMaxRewind(
+	TEXT("TPS.LagComp.MaxRewind"),
+	LagCompMaxRewind,
+	TEXT("Max seconds character can be rewound, more ping is not compensated"),
+	ECVF_Default);
+
+float LagCompMinRewind = 0.02f;
+FAutoConsoleVariableRef CVarLagCompMinRewind(
+	TEXT("TPS.LagComp.MinRewind"),
+	LagCompMinRewind,
+	TEXT("Shooter with less latency is not compensated"),
+	ECVF_Default);
+
+void UTPSLagCompensationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const int32 SlotNum = FMath::Max(LagCompMaxCharacters, 1);
+	const int32 FrameNum = FMath::CeilToInt(FMath::Max(LagCompHistoryTime, 0.1f) * FMath::Max(LagCompRecordRate, 1.0f)) + 1;
+
+	SlotCharacters.SetNumZeroed(SlotNum);
+	SlotBoundRadius.SetNumZeroed(SlotNum);
+	SlotStartTime.SetNumZeroed(SlotNum);
+	FrameTimes.SetNumZeroed(FrameNum);
+	FrameLocations.SetNumZeroed(FrameNum * SlotNum);
+
+	ShapesPerSlot = FMath::Max(LagCompMaxShapes, 1);
+	SlotShapes.SetNum(SlotNum * ShapesPerSlot);
+	SlotShapesNum.SetNumZeroed(SlotNum);
+	FrameShapeLocations.SetNumZeroed(FrameNum * SlotNum * ShapesPerSlot);
+	FrameShapeRotations.Init(FQuat::Identity, FrameNum * SlotNum * ShapesPerSlot);
+}
+
+void UTPSLagCompensationSubsystem::Deinitialize()
+{
+	RestoreCharacters();
+
+	SlotCharacters.Empty();
+	SlotBoundRadius.Empty();
+	SlotStartTime.Empty();
+	FrameTimes.Empty();
+	FrameLocations.Empty();
+	SlotShapes.Empty();
+	SlotShapesNum.Empty();
+	FrameShapeLocations.Empty();
+	FrameShapeRotations.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (LastRecordTime < 0.0f || Now - LastRecordTime >= 1.0f / FMath::Max(LagCompRecordRate, 1.0f) - KINDA_SMALL_NUMBER)
+	{
+		RecordFrame(Now);
+	}
+}
+
+bool UTPSLagCompensationSubsystem::IsTickable() const
+{
+	UWorld* myWorld = GetWorld();
+	return LagCompEnable && myWorld && myWorld->IsGameWorld() && myWorld->GetNetMode() != NM_Client && myWorld->GetNetMode() != NM_Standalone;
+}
+
+ETickableTickType UTPSLagCompensationSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSLagCompensationSubsystem::RegisterCharacter(ACharacter* Character)
+{
+	if (!Character || SlotCharacters.Contains(Character))
+		return;
+
+	const int32 Slot = SlotCharacters.Find(nullptr);
+	if (Slot == INDEX_NONE)
+	{
+		UE_LOG(LogTPS, Warning, TEXT("UTPSLagCompensationSubsystem::RegisterCharacter - no free slot for %s, TPS.LagComp.MaxCharacters = %d"), *Character->GetName(), SlotCharacters.Num());
+		return;
+	}
+
+	SlotCharacters[Slot] = Character;
+	SlotStartTime[Slot] = GetWorld()->GetTimeSeconds();
+	SlotBoundRadius[Slot] = Character->GetCapsuleComponent() ? Character->GetCapsuleComponent()->GetScaledCapsuleHalfHeight() : 100.0f;
+	GatherShapes(Slot, Character);
+}
+
+void UTPSLagCompensationSubsystem::GatherShapes(int32 Slot, ACharacter* Character)
+{
+	//what weapon traces hit: hit proxies, or mesh bodies if character has none
+	TArray<UPrimitiveComponent*> myShapes;
+	UTPSHitProxyComponent* myHitProxy = Character->FindComponentByClass<UTPSHitProxyComponent>();
+	if (myHitProxy)
+	{
+		for (UShapeComponent* Proxy : myHitProxy->GetProxies())
+		{
+			if (Proxy)
+				myShapes.Add(Proxy);
+		}
+	}
+	if (myShapes.Num() == 0 && Character->GetMesh())
+	{
+		myShapes.Add(Character->GetMesh());
+	}
+
+	if (myShapes.Num() > ShapesPerSlot)
+	{
+		UE_LOG(LogTPS, Warning, TEXT("UTPSLagCompensationSubsystem::GatherShapes - %s has %d hit shapes, TPS.LagComp.MaxShapes = %d"), *Character->GetName(), myShapes.Num(), ShapesPerSlot);
+	}
+
+	SlotShapesNum[Slot] = FMath::Min(myShapes.Num(), ShapesPerSlot);
+	for (int32 i = 0; i < ShapesPerSlot; i++)
+	{
+		SlotShapes[Slot * ShapesPerSlot + i] = i < SlotShapesNum[Slot] ? myShapes[i] : nullptr;
+	}
+}
+
+void UTPSLagCompensationSubsystem::UnregisterCharacter(ACharacter* Character)
+{
+	const int32 Slot = SlotCharacters.Find(Character);
+	if (Slot != INDEX_NONE)
+	{
+		SlotCharacters[Slot] = nullptr;
+		SlotShapesNum[Slot] = 0;
+	}
+}
+
+int32 UTPSLagCompensationSubsystem::RewindForShot(APawn* Shooter, const FVector& Start, const TArray<FVector>& TraceEnds, float ShotTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_LagCompRewind);
+
+	if (!LagCompEnable || FramesNum == 0 || TraceEnds.Num() == 0)
+		return 0;
+
+	const float RewindTime = GetRewindTime(Shooter);
+	if (RewindTime < LagCompMinRewind)
+		return 0;
+
+	const float TargetTime = FMath::Min(ShotTime, GetWorld()->GetTimeSeconds()) - RewindTime;
+	const int32 SlotNum = SlotCharacters.Num();
+	int32 RewoundNum = 0;
+
+	for (int32 Slot = 0; Slot < SlotNum; Slot++)
+	{
+		ACharacter* myCharacter = SlotCharacters[Slot];
+		if (!myCharacter || myCharacter == Shooter || !IsValid(myCharacter))
+			continue;
+
+		int32 Older, Newer;
+		float Alpha;
+		if (!FindHistoryFrames(Slot, TargetTime, Older, Newer, Alpha))
+			continue;
+		const FVector RewindLocation = FMath::Lerp(FrameLocations[Older * SlotNum + Slot], FrameLocations[Newer * SlotNum + Slot], Alpha);
+
+		//bounding sphere of capsule against every ray of shot
+		const float BoundRadiusSq = FMath::Square(SlotBoundRadius[Slot]);
+		bool bNearRay = false;
+		for (int32 i = 0; i < TraceEnds.Num() && !bNearRay; i++)
+		{
+			bNearRay = FMath::PointDistToSegmentSquared(RewindLocation, Start, TraceEnds[i]) <= BoundRadiusSq;
+		}
+		if (!bNearRay)
+			continue;
+
+		//shapes keep recorded pose and yaw, not only actor location
+		const int32 BodiesNum = RewoundBodies.Num();
+		for (int32 Shape = 0; Shape < SlotShapesNum[Slot]; Shape++)
+		{
+			UPrimitiveComponent* myShape = SlotShapes[Slot * ShapesPerSlot + Shape].Get();
+			if (!myShape)
+				continue;
+
+			const int32 OlderIndex = (Older * SlotNum + Slot) * ShapesPerSlot + Shape;
+			const int32 NewerIndex = (Newer * SlotNum + Slot) * ShapesPerSlot + Shape;
+			const FTransform RewindTransform(
+				FQuat::Slerp(FrameShapeRotations[OlderIndex], FrameShapeRotations[NewerIndex], Alpha),
+				FMath::Lerp(FrameShapeLocations[OlderIndex], FrameShapeLocations[NewerIndex], Alpha),
+				myShape->GetComponentScale());
+			RewindShape(myShape, RewindTransform);
+		}
+		RewoundNum += RewoundBodies.Num() > BodiesNum ? 1 : 0;
+	}
+
+	INC_DWORD_STAT_BY(STAT_TPS_LagCompRewoundCharacters, RewoundNum);
+	return RewoundNum;
+}
+
+void UTPSLagCompensationSubsystem::RewindShape(UPrimitiveComponent* Shape, const FTransform& RewindTransform)
+{
+	const FTransform& CurrentTransform = Shape->GetComponentTransform();
+	if (CurrentTransform.Equals(RewindTransform, 0.5f))
+		return;
+
+	//skeletal mesh has body per bone, they are moved with component keeping current pose
+	TArray<FBodyInstance*, TInlineAllocator<1>> myBodies;
+	USkeletalMeshComponent* myMesh = Cast<USkeletalMeshComponent>(Shape);
+	if (myMesh)
+		myBodies.Append(myMesh->Bodies);
+	else
+		myBodies.Add(Shape->GetBodyInstance());
+
+	for (FBodyInstance* Body : myBodies)
+	{
+		if (!Body || !Body->IsValidBodyInstance())
+			continue;
+
+		FTPSRewoundBody& Rewound = RewoundBodies.AddDefaulted_GetRef();
+		Rewound.Body = Body;
+		Rewound.SavedTransform = Body->GetUnrealWorldTransform();
+		Body->SetBodyTransform(Rewound.SavedTransform.GetRelativeTransform(CurrentTransform) * RewindTransform, ETeleportType::TeleportPhysics);
+	}
+}
+
+void UTPSLagCompensationSubsystem::RestoreCharacters()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_LagCompRewind);
+
+	//bodies are not freed between rewind and restore, traces are done in same frame
+	for (const FTPSRewoundBody& Rewound : RewoundBodies)
+	{
+		Rewound.Body->SetBodyTransform(Rewound.SavedTransform, ETeleportType::TeleportPhysics);
+	}
+	RewoundBodies.Reset();
+}
+
+float UTPSLagCompensationSubsystem::GetRewindTime(APawn* Shooter) const
+{
+	//locally controlled shooter on listen server see real positions
+	if (!Shooter || Shooter->IsLocallyControlled() || !Shooter->GetPlayerState())
+		return 0.0f;
+
+	//ExactPing is round trip in ms: client see characters one way late and his shot come one way late
+	return FMath::Min(Shooter->GetPlayerState()->ExactPing * 0.001f, LagCompMaxRewind);
+}
+
+void UTPSLagCompensationSubsystem::RecordFrame(float Now)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_LagCompRecord);
+
+	const int32 SlotNum = SlotCharacters.Num();
+	NewestFrame = (NewestFrame + 1) % FrameTimes.Num();
+	FramesNum = FMath::Min(FramesNum + 1, FrameTimes.Num());
+	FrameTimes[NewestFrame] = Now;
+	LastRecordTime = Now;
+
+	FVector* FrameData = FrameLocations.GetData() + NewestFrame * SlotNum;
+	const int32 FrameShapes = NewestFrame * SlotNum * ShapesPerSlot;
+	for (int32 Slot = 0; Slot < SlotNum; Slot++)
+	{
+		ACharacter* myCharacter = SlotCharacters[Slot];
+		if (myCharacter)
+		{
+			FrameData[Slot] = myCharacter->GetActorLocation();
+
+			for (int32 Shape = 0; Shape < SlotShapesNum[Slot]; Shape++)
+			{
+				const UPrimitiveComponent* myShape = SlotShapes[Slot * ShapesPerSlot + Shape].Get();
+				if (myShape)
+				{
+					const int32 Index = FrameShapes + Slot * ShapesPerSlot + Shape;
+					FrameShapeLocations[Index] = myShape->GetComponentLocation();
+					FrameShapeRotations[Index] = myShape->GetComponentQuat();
+				}
+			}
+		}
+	}
+}
+
+bool UTPSLagCompensationSubsystem::FindHistoryFrames(int32 Slot, float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const
+{
+	//character registered later than time, nothing to rewind to
+	if (Time < SlotStartTime[Slot])
+		return false;
+
+	const int32 FrameNum = FrameTimes.Num();
+
+	//newest to oldest, find first frame not newer than Time
+	int32 NewerFrame = INDEX_NONE;
+	for (int32 i = 0; i < FramesNum; i++)
+	{
+		const int32 Frame = (NewestFrame - i + FrameNum) % FrameNum;
+		if (FrameTimes[Frame] < SlotStartTime[Slot])
+			break;
+
+		if (FrameTimes[Frame] <= Time)
+		{
+			OutOlder = Frame;
+			OutNewer = NewerFrame == INDEX_NONE ? Frame : NewerFrame;
+			OutAlpha = NewerFrame == INDEX_NONE ? 0.0f : (Time - FrameTimes[Frame]) / FMath::Max(FrameTimes[NewerFrame] - FrameTimes[Frame], KINDA_SMALL_NUMBER);
+			return true;
+		}
+		NewerFrame = Frame;
+	}
+	return false;
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSLagCompensationSubsystem.generated.h"
+
+class ACharacter;
+class UPrimitiveComponent;
+struct FBodyInstance;
+
+//collision body moved back for hitscan shot, restored after traces
+struct FTPSRewoundBody
+{
+	FBodyInstance* Body = nullptr;
+	FTransform SavedTransform;
+};
+
+/**
+ * Server hitbox history for lag compensated hitscan. Every record step location and hit shape transforms (hit proxies
+ * or skeletal mesh) of all registered characters are written to one frame of ring buffer (frame major, slot minor).
+ * Shot of high ping client move physics bodies of characters near his rays to time client saw them, trace and restore.
+ * Components are not moved, so rewind has no overlap, movement or render side effects.
+ */
+UCLASS()
+class TPS_API UTPSLagCompensationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	UFUNCTION(BlueprintCallable, Category = "LagCompensation")
+	void RegisterCharacter(ACharacter* Character);
+	UFUNCTION(BlueprintCallable, Category = "LagCompensation")
+	void UnregisterCharacter(ACharacter* Character);
+
+	//move characters close to shot rays to time Shooter saw them at ShotTime, return number moved. RestoreCharacters must be called after traces
+	int32 RewindForShot(APawn* Shooter, const FVector& Start, const TArray<FVector>& TraceEnds, float ShotTime);
+	void RestoreCharacters();
+
+	//how far in past shooter see other characters
+	float GetRewindTime(APawn* Shooter) const;
+
+protected:
+	void RecordFrame(float Now);
+	//frames around Time, Older == Newer if Time is newest
+	bool FindHistoryFrames(int32 Slot, float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const;
+	void GatherShapes(int32 Slot, ACharacter* Character);
+	void RewindShape(UPrimitiveComponent* Shape, const FTransform& RewindTransform);
+
+	//slot -> character, null slot is free
+	UPROPERTY()
+	TArray<ACharacter*> SlotCharacters;
+	//capsule bounding sphere by slot
+	TArray<float> SlotBoundRadius;
+	TArray<float> SlotStartTime;
+
+	//ring of frames
+	TArray<float> FrameTimes;
+	//FrameTimes.Num() * SlotCharacters.Num(), location of slot in frame is [Frame * SlotNum + Slot]
+	TArray<FVector> FrameLocations;
+	//hit shapes of slot are [Slot * ShapesPerSlot + Shape], their transform in frame [(Frame * SlotNum + Slot) * ShapesPerSlot + Shape]
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> SlotShapes;
+	TArray<int32> SlotShapesNum;
+	TArray<FVector> FrameShapeLocations;
+	TArray<FQuat> FrameShapeRotations;
+	int32 ShapesPerSlot = 1;
+	int32 NewestFrame = -1;
+	int32 FramesNum = 0;
+	float LastRecordTime = -1.0f;
+
+	TArray<FTPSRewoundBody> RewoundBodies;
+};
@@ -25,3 +25,8 @@ void ITPS_IGameActor::AddEffect(UTPS_StateEffect* newEffect)
 {
 
 }
+
+int32 ITPS_IGameActor::GetEffectNumByClass(UClass* EffectClass)
+{
+	return 0;
+}
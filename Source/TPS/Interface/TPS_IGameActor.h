@@ -29,6 +29,8 @@ public:
 	virtual TArray<UTPS_StateEffect*> GetAllCurrentEffects();
 	virtual void RemoveEffect(UTPS_StateEffect* RemoveEffect);
 	virtual void AddEffect(UTPS_StateEffect* newEffect);
+	//active effects of exactly this class, for not stackable effects
+	virtual int32 GetEffectNumByClass(UClass* EffectClass);
 
 	//inv
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent)
@@ -0,0 +1,271 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSStateEffectSubsystem.h"
+#include "Engine/World.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "../Character/TPSHealthComponent.h"
+#include "../Character/TPSCharacterHealthComponent.h"
+#include "../Interface/TPS_IGameActor.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("StateEffect Tick"), STAT_TPS_StateEffectTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("State Effects Active"), STAT_TPS_StateEffectsActive, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Effect Emitters Pooled"), STAT_TPS_EffectEmittersPooled, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Effect Emitters Spawned"), STAT_TPS_EffectEmittersSpawned, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Effect Emitters Reused"), STAT_TPS_EffectEmittersReused, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Effect Emitters Skipped"), STAT_TPS_EffectEmittersSkipped, STATGROUP_TPS);
+
+int32 StateEffectMaxEmittersPerActor = 2;
+FAutoConsoleVariableRef CVarStateEffectMaxEmittersPerActor(
+	TEXT("TPS.StateEffect.MaxEmittersPerActor"),
+	StateEffectMaxEmittersPerActor,
+	TEXT("Max live effect emitters on one actor, more effects work without particle"),
+	ECVF_Default);
+
+int32 StateEffectMaxPooledEmitters = 16;
+FAutoConsoleVariableRef CVarStateEffectMaxPooledEmitters(
+	TEXT("TPS.StateEffect.MaxPooledEmitters"),
+	StateEffectMaxPooledEmitters,
+	TEXT("Max not active emitters kept for one ParticleEffect template"),
+	ECVF_Default);
+
+void UTPSStateEffectSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_StateEffectsActive, ActiveEffects.Num());
+	ActiveEffects.Empty();
+
+	for (const TPair<UParticleSystem*, FTPSEffectEmitterPool>& Pool : EmitterPools)
+	{
+		DEC_DWORD_STAT_BY(STAT_TPS_EffectEmittersPooled, Pool.Value.FreeEmitters.Num());
+	}
+	EmitterPools.Empty();
+	EmitterNumByTarget.Empty();
+	EmittersHolder = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UTPSStateEffectSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_StateEffectTick);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	for (int32 i = ActiveEffects.Num() - 1; i >= 0; i--)
+	{
+		FTPSActiveStateEffect& Effect = ActiveEffects[i];
+		if (!IsValid(Effect.Target))
+		{
+			EndTimerEffect(i);
+			continue;
+		}
+
+		//several executes in one frame if RateTime is less than frame
+		while (Effect.NextExecuteTime <= Now && Effect.NextExecuteTime <= Effect.EndTime)
+		{
+			if (IsValid(Effect.HealthComponent))
+				Effect.HealthComponent->ChangeHealthValue(Effect.Archetype->Power);
+			Effect.NextExecuteTime += FMath::Max(Effect.Archetype->RateTime, KINDA_SMALL_NUMBER);
+		}
+
+		if (Now >= Effect.EndTime)
+		{
+			EndTimerEffect(i);
+		}
+	}
+}
+
+bool UTPSStateEffectSubsystem::IsTickable() const
+{
+	return ActiveEffects.Num() > 0;
+}
+
+ETickableTickType UTPSStateEffectSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSStateEffectSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSStateEffectSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSStateEffectSubsystem::ApplyEffect(TSubclassOf<UTPS_StateEffect> EffectClass, AActor* Target, FName NameBoneHit)
+{
+	if (!EffectClass || !Target)
+		return;
+
+	UTPS_StateEffect* myEffect = Cast<UTPS_StateEffect>(EffectClass->GetDefaultObject());
+	if (UTPS_StateEffect_ExecuteTimer* myTimerEffect = Cast<UTPS_StateEffect_ExecuteTimer>(myEffect))
+	{
+		StartTimerEffect(myTimerEffect, Target);
+	}
+	else if (UTPS_StateEffect_ExecuteOnce* myOnceEffect = Cast<UTPS_StateEffect_ExecuteOnce>(myEffect))
+	{
+		UTPSHealthComponent* myHealthComp = Target->FindComponentByClass<UTPSHealthComponent>();
+		if (myHealthComp)
+		{
+			myHealthComp->ChangeHealthValue(myOnceEffect->Power);
+		}
+	}
+	else
+	{
+		UTPS_StateEffect* NewEffect = NewObject<UTPS_StateEffect>(Target, EffectClass);
+		if (NewEffect)
+		{
+			NewEffect->InitObject(Target, NameBoneHit);
+		}
+	}
+}
+
+void UTPSStateEffectSubsystem::RemoveEffectsFromTarget(AActor* Target)
+{
+	for (int32 i = ActiveEffects.Num() - 1; i >= 0; i--)
+	{
+		if (ActiveEffects[i].Target == Target)
+		{
+			EndTimerEffect(i);
+		}
+	}
+}
+
+void UTPSStateEffectSubsystem::StartTimerEffect(UTPS_StateEffect_ExecuteTimer* Archetype, AActor* Target)
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	FTPSActiveStateEffect& Effect = ActiveEffects.AddDefaulted_GetRef();
+	Effect.Target = Target;
+	Effect.Archetype = Archetype;
+	Effect.HealthComponent = Target->FindComponentByClass<UTPSHealthComponent>();
+	Effect.NextExecuteTime = Now + Archetype->RateTime;
+	Effect.EndTime = Now + Archetype->Timer;
+	INC_DWORD_STAT(STAT_TPS_StateEffectsActive);
+
+	if (Archetype->ParticleEffect)
+	{
+		Effect.ParticleEmitter = AcquireEmitter(Archetype->ParticleEffect, Target);
+	}
+
+	UTPSCharacterHealthComponent* myCharHealthComp = Cast<UTPSCharacterHealthComponent>(Effect.HealthComponent);
+	if (myCharHealthComp)
+	{
+		myCharHealthComp->HealthChangeBlock = Archetype->LocalHealthChangeBlock;
+	}
+
+	ITPS_IGameActor* myInterface = Cast<ITPS_IGameActor>(Target);
+	if (myInterface)
+	{
+		myInterface->AddEffect(Archetype);
+	}
+}
+
+void UTPSStateEffectSubsystem::EndTimerEffect(int32 Index)
+{
+	FTPSActiveStateEffect& Effect = ActiveEffects[Index];
+
+	if (IsValid(Effect.Target))
+	{
+		UTPSCharacterHealthComponent* myCharHealthComp = Cast<UTPSCharacterHealthComponent>(Effect.HealthComponent);
+		if (IsValid(myCharHealthComp))
+		{
+			myCharHealthComp->HealthChangeBlock = 0;
+		}
+
+		ITPS_IGameActor* myInterface = Cast<ITPS_IGameActor>(Effect.Target);
+		if (myInterface)
+		{
+			myInterface->RemoveEffect(Effect.Archetype);
+		}
+	}
+
+	if (Effect.ParticleEmitter)
+	{
+		ReleaseEmitter(Effect.ParticleEmitter, Effect.Target);
+	}
+
+	ActiveEffects.RemoveAtSwap(Index, 1, false);
+	DEC_DWORD_STAT(STAT_TPS_StateEffectsActive);
+}
+
+UParticleSystemComponent* UTPSStateEffectSubsystem::AcquireEmitter(UParticleSystem* Template, AActor* Target)
+{
+	int32& EmitterNum = EmitterNumByTarget.FindOrAdd(Target);
+	if (EmitterNum >= StateEffectMaxEmittersPerActor)
+	{
+		INC_DWORD_STAT(STAT_TPS_EffectEmittersSkipped);
+		return nullptr;
+	}
+
+	USceneComponent* myParent = Target->FindComponentByClass<USkeletalMeshComponent>();
+	if (!myParent)
+		myParent = Target->GetRootComponent();
+	if (!myParent)
+		return nullptr;
+
+	UParticleSystemComponent* myEmitter = nullptr;
+	TArray<UParticleSystemComponent*>& FreeEmitters = EmitterPools.FindOrAdd(Template).FreeEmitters;
+	while (!myEmitter && FreeEmitters.Num() > 0)
+	{
+		myEmitter = FreeEmitters.Pop(false);
+		DEC_DWORD_STAT(STAT_TPS_EffectEmittersPooled);
+		if (!IsValid(myEmitter))
+			myEmitter = nullptr;
+	}
+
+	if (myEmitter)
+	{
+		INC_DWORD_STAT(STAT_TPS_EffectEmittersReused);
+	}
+	else
+	{
+		if (!EmittersHolder)
+		{
+			FActorSpawnParameters Param;
+			Param.ObjectFlags |= RF_Transient;
+			EmittersHolder = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, Param);
+			if (!EmittersHolder)
+				return nullptr;
+
+			USceneComponent* myRoot = NewObject<USceneComponent>(EmittersHolder, TEXT("Root"));
+			EmittersHolder->SetRootComponent(myRoot);
+			myRoot->RegisterComponent();
+		}
+
+		myEmitter = NewObject<UParticleSystemComponent>(EmittersHolder);
+		myEmitter->bAutoActivate = false;
+		myEmitter->bAutoDestroy = false;
+		myEmitter->SetTemplate(Template);
+		myEmitter->SetupAttachment(EmittersHolder->GetRootComponent());
+		myEmitter->RegisterComponent();
+		INC_DWORD_STAT(STAT_TPS_EffectEmittersSpawned);
+	}
+
+	myEmitter->AttachToComponent(myParent, FAttachmentTransformRules::SnapToTargetIncludingScale);
+	myEmitter->ActivateSystem(true);
+	EmitterNum++;
+
+	return myEmitter;
+}
+
+void UTPSStateEffectSubsystem::ReleaseEmitter(UParticleSystemComponent* Emitter, AActor* Target)
+{
+	int32* EmitterNum = EmitterNumByTarget.Find(Target);
+	if (EmitterNum && --(*EmitterNum) <= 0)
+		EmitterNumByTarget.Remove(Target);
+
+	if (!IsValid(Emitter))
+		return;
+
+	FTPSEffectEmitterPool* myPool = EmitterPools.Find(Emitter->Template);
+	if (!myPool || !EmittersHolder || myPool->FreeEmitters.Num() >= StateEffectMaxPooledEmitters)
+	{
+		Emitter->DestroyComponent();
+		return;
+	}
+
+	//target can be destroyed soon, emitter go back to holder
+	Emitter->DeactivateImmediate();
+	Emitter->AttachToComponent(EmittersHolder->GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
+	myPool->FreeEmitters.Add(Emitter);
+	INC_DWORD_STAT(STAT_TPS_EffectEmittersPooled);
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPS_StateEffect.h"
+#include "TPSStateEffectSubsystem.generated.h"
+
+class UTPSHealthComponent;
+
+//one application of timer effect, settings are read from class default object of effect
+USTRUCT()
+struct FTPSActiveStateEffect
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	AActor* Target = nullptr;
+	UPROPERTY()
+	UTPS_StateEffect_ExecuteTimer* Archetype = nullptr;
+	UPROPERTY()
+	UTPSHealthComponent* HealthComponent = nullptr;
+	UPROPERTY()
+	UParticleSystemComponent* ParticleEmitter = nullptr;
+
+	float NextExecuteTime = 0.0f;
+	float EndTime = 0.0f;
+};
+
+//not active emitters of one ParticleEffect template
+USTRUCT()
+struct FTPSEffectEmitterPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> FreeEmitters;
+};
+
+/**
+ * Active state effects of all actors in one array, timer effects are executed in one pass in Tick instead of
+ * UObject and two world timers per application. Blueprint effect classes are only read through their default object,
+ * actors get the default object in AddEffect/RemoveEffect.
+ */
+UCLASS()
+class TPS_API UTPSStateEffectSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	//execute once effects apply at once, timer effects are added to simulation, other effect classes use object InitObject
+	void ApplyEffect(TSubclassOf<UTPS_StateEffect> EffectClass, AActor* Target, FName NameBoneHit);
+	//end all effects on target, without last execute
+	UFUNCTION(BlueprintCallable, Category = "StateEffect")
+	void RemoveEffectsFromTarget(AActor* Target);
+
+	UFUNCTION(BlueprintCallable, Category = "StateEffect")
+	int32 GetActiveEffectsNum() const { return ActiveEffects.Num(); }
+
+protected:
+	void StartTimerEffect(UTPS_StateEffect_ExecuteTimer* Archetype, AActor* Target);
+	void EndTimerEffect(int32 Index);
+
+	//emitter attached to target from pool of template, null when target has TPS.StateEffect.MaxEmittersPerActor already
+	UParticleSystemComponent* AcquireEmitter(UParticleSystem* Template, AActor* Target);
+	void ReleaseEmitter(UParticleSystemComponent* Emitter, AActor* Target);
+
+	UPROPERTY()
+	TArray<FTPSActiveStateEffect> ActiveEffects;
+
+	UPROPERTY()
+	TMap<UParticleSystem*, FTPSEffectEmitterPool> EmitterPools;
+	//live emitters by target, only counted
+	TMap<AActor*, int32> EmitterNumByTarget;
+	//outer of pooled emitters, so they are not destroyed with target actor
+	UPROPERTY()
+	AActor* EmittersHolder = nullptr;
+};
@@ -36,6 +36,31 @@ void UTPS_StateEffect::DestroyObject()
 	}	
 }
 
+#if WITH_EDITOR
+void UTPS_StateEffect::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	bSurfaceMaskValid = false;
+}
+#endif
+
+bool UTPS_StateEffect::CanInteractWithSurface(EPhysicalSurface SurfaceType) const
+{
+	static_assert(SurfaceType_Max <= 64, "surface mask is uint64");
+
+	if (!bSurfaceMaskValid)
+	{
+		SurfaceMask = 0;
+		for (const TEnumAsByte<EPhysicalSurface>& Surface : PossibleInteractSurface)
+		{
+			SurfaceMask |= 1ull << (uint8)Surface.GetValue();
+		}
+		bSurfaceMaskValid = true;
+	}
+	return (SurfaceMask & (1ull << (uint8)SurfaceType)) != 0;
+}
+
 bool UTPS_StateEffect_ExecuteOnce::InitObject(AActor* Actor, FName NameBoneHit)
 {
 	Super::InitObject(Actor, NameBoneHit);
@@ -20,6 +20,13 @@ public:
 	
 	virtual bool InitObject(AActor* Actor, FName NameBoneHit);
 	virtual void DestroyObject();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	//bit per surface type of PossibleInteractSurface, built on first call, use on class default object
+	bool CanInteractWithSurface(EPhysicalSurface SurfaceType) const;
 	
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setting")
 	TArray<TEnumAsByte<EPhysicalSurface>> PossibleInteractSurface;
@@ -28,6 +35,10 @@ public:
 	bool bIsStakable = false;
 
 	AActor* myActor = nullptr;
+
+private:
+	mutable uint64 SurfaceMask = 0;
+	mutable bool bSurfaceMaskValid = false;
 };
 
 UCLASS()
@@ -48,10 +48,23 @@ TArray<UTPS_StateEffect*> ATPS_EnvironmentStructure::GetAllCurrentEffects()
 
 void ATPS_EnvironmentStructure::RemoveEffect(UTPS_StateEffect* RemoveEffect)
 {
-	Effects.Remove(RemoveEffect);
+	if (Effects.RemoveSingle(RemoveEffect) > 0 && RemoveEffect)
+	{
+		int32* EffectNum = EffectNumByClass.Find(RemoveEffect->GetClass());
+		if (EffectNum && --(*EffectNum) <= 0)
+			EffectNumByClass.Remove(RemoveEffect->GetClass());
+	}
 }
 
 void ATPS_EnvironmentStructure::AddEffect(UTPS_StateEffect* newEffect)
 {
 	Effects.Add(newEffect);
+	if (newEffect)
+		EffectNumByClass.FindOrAdd(newEffect->GetClass())++;
+}
+
+int32 ATPS_EnvironmentStructure::GetEffectNumByClass(UClass* EffectClass)
+{
+	const int32* EffectNum = EffectNumByClass.Find(EffectClass);
+	return EffectNum ? *EffectNum : 0;
 }
\ No newline at end of file
@@ -31,8 +31,10 @@ public:
 	TArray<UTPS_StateEffect*> GetAllCurrentEffects() override;
 	void RemoveEffect(UTPS_StateEffect* RemoveEffect)override;
 	void AddEffect(UTPS_StateEffect* newEffect)override;
+	int32 GetEffectNumByClass(UClass* EffectClass) override;
 
 	//Effect
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Setting")
 	TArray<UTPS_StateEffect*> Effects;
+	TMap<UClass*, int32> EffectNumByClass;
 };
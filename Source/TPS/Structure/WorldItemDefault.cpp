@@ -2,6 +2,8 @@
 
 
 #include "WorldItemDefault.h"
+#include "../Game/TPSGameInstance.h"
+#include "Net/UnrealNetwork.h"
 
 // Sets default values
 AWorldItemDefault::AWorldItemDefault()
@@ -16,6 +18,37 @@ void AWorldItemDefault::BeginPlay()
 {
 	Super::BeginPlay();
 	
+	//client spawn pickup when it become relevant and destroy when it is not
+	SetStreamWeaponName(StreamWeaponName);
+}
+
+void AWorldItemDefault::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetStreamWeaponName(NAME_None);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AWorldItemDefault::OnRep_StreamWeaponName()
+{
+	SetStreamWeaponName(StreamWeaponName);
+}
+
+void AWorldItemDefault::SetStreamWeaponName(FName NewWeaponName)
+{
+	StreamWeaponName = NewWeaponName;
+	if (StreamedWeaponName == NewWeaponName)
+		return;
+
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+	if (!myGI)
+		return;
+
+	if (!StreamedWeaponName.IsNone())
+		myGI->ReleaseWeaponAssets(StreamedWeaponName);
+	StreamedWeaponName = NewWeaponName;
+	if (!StreamedWeaponName.IsNone())
+		myGI->RequestWeaponAssets(StreamedWeaponName);
 }
 
 // Called every frame
@@ -25,3 +58,9 @@ void AWorldItemDefault::Tick(float DeltaTime)
 
 }
 
+void AWorldItemDefault::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AWorldItemDefault, StreamWeaponName);
+}
@@ -18,9 +18,23 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	//weapon of pickup, its assets are streamed while pickup is relevant so taken weapon is ready to fire
+	UPROPERTY(ReplicatedUsing = OnRep_StreamWeaponName, EditAnywhere, BlueprintReadWrite, Category = "Item", meta = (ExposeOnSpawn = "true"))
+	FName StreamWeaponName;
+	//for pickup spawned by drop, name is known only after spawn
+	UFUNCTION(BlueprintCallable, Category = "Item")
+	void SetStreamWeaponName(FName NewWeaponName);
+	UFUNCTION()
+	void OnRep_StreamWeaponName();
+
+protected:
+	FName StreamedWeaponName;
 
 };
@@ -6,3 +6,5 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTPS, Log, All);
 DECLARE_LOG_CATEGORY_EXTERN(LogTPS_Net, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("TPS"), STATGROUP_TPS, STATCAT_Advanced);
@@ -3,12 +3,16 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/GameEngine.h"
 #include "Perception/AISense_Damage.h"
+#include "TPSProjectilePoolSubsystem.h"
+#include "TPSDecalSubsystem.h"
+#include "TPSProjectileArchetypeSubsystem.h"
+#include "../Character/TPSHitProxyComponent.h"
 
 // Sets default values
 AProjectileDefault::AProjectileDefault()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	//life time is scheduled in UTPSProjectileSchedulerSubsystem, movement component tick itself
+	PrimaryActorTick.bCanEverTick = false;
 
 	SetReplicates(true);
 
@@ -50,47 +54,58 @@ void AProjectileDefault::BeginPlay()
 {
 	Super::BeginPlay();
 
+	//projectile spawned by pool on server come to client already hidden
+	if (!HasAuthority() && IsHidden())
+	{
+		EnterPool();
+	}
 }
 
-// Called every frame
-void AProjectileDefault::Tick(float DeltaTime)
+void AProjectileDefault::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	RemoveRenderInstances();
 
+	Super::EndPlay(EndPlayReason);
 }
 
 void AProjectileDefault::BulletCollisionSphereHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
+	const FTPSProjectileArchetype* myArchetype = GetArchetype();
+	if (!myArchetype)
+	{
+		ImpactProjectile();
+		return;
+	}
+
 	if (OtherActor && Hit.PhysMaterial.IsValid())
 	{
 		EPhysicalSurface mySurfacetype = UGameplayStatics::GetSurfaceType(Hit);
 
-		if (ProjectileSetting.HitDecals.Contains(mySurfacetype))
+		UMaterialInterface* myMaterial = myArchetype->GetHitDecal(mySurfacetype);
+		if (myMaterial && OtherComp)
 		{
-			UMaterialInterface* myMaterial = ProjectileSetting.HitDecals[mySurfacetype];
-
-			if (myMaterial && OtherComp)
-			{
-				SpawnHitDecal_Multicast(myMaterial, OtherComp, Hit);
-			}
+			SpawnHitDecal_Multicast(myMaterial, OtherComp, Hit);
 		}
-		if (ProjectileSetting.HitFXs.Contains(mySurfacetype))
+		UParticleSystem* myParticle = myArchetype->GetHitFX(mySurfacetype);
+		if (myParticle)
 		{
-			UParticleSystem* myParticle = ProjectileSetting.HitFXs[mySurfacetype];
-			if (myParticle)
-			{
-				SpawnHitFX_Multicast(myParticle, Hit);
-			}
+			SpawnHitFX_Multicast(myParticle, Hit);
 		}
 
-		if (ProjectileSetting.HitSound)
+		USoundBase* mySound = myArchetype->GetHitSound();
+		if (mySound)
 		{
-			SpawnHitSound_Multicast(ProjectileSetting.HitSound, Hit);
+			SpawnHitSound_Multicast(mySound, Hit);
 		}
-		UTypes::AddEffectBySurfaceType(Hit.GetActor(), Hit.BoneName, ProjectileSetting.Effect, mySurfacetype);
+		if (!bCosmetic)
+			UTypes::AddEffectBySurfaceType(Hit.GetActor(), UTPSHitProxyComponent::GetHitBoneName(Hit), myArchetype->Info.Effect, mySurfacetype);
+	}
+	if (!bCosmetic)
+	{
+		const float myDamage = myArchetype->Info.ProjectileDamage * UTPSHitProxyComponent::GetDamageMultiplier(Hit);
+		UGameplayStatics::ApplyPointDamage(OtherActor, myDamage, Hit.TraceStart, Hit, GetInstigatorController(), this, NULL);
+		UAISense_Damage::ReportDamageEvent(GetWorld(), Hit.GetActor(), GetInstigator(), myDamage, Hit.Location, Hit.Location);
 	}
-	UGameplayStatics::ApplyPointDamage(OtherActor, ProjectileSetting.ProjectileDamage, Hit.TraceStart, Hit, GetInstigatorController(), this, NULL);
-	UAISense_Damage::ReportDamageEvent(GetWorld(), Hit.GetActor(), GetInstigator(), ProjectileSetting.ProjectileDamage, Hit.Location, Hit.Location);
 
 	ImpactProjectile();
 }
@@ -105,36 +120,154 @@ void AProjectileDefault::BulletCollisionSphereEndOverlap(UPrimitiveComponent* Ov
 
 void AProjectileDefault::InitProjectile(FProjectileInfo InitParam)
 {
-	ProjectileSetting = InitParam;
-	BulletProjectileMovement->InitialSpeed = ProjectileSetting.ProjectileInitSpeed;
-	BulletProjectileMovement->MaxSpeed = ProjectileSetting.ProjectileMaxSpeed;
-	this->SetLifeSpan(ProjectileSetting.ProjectileLifeTime);
-	if (ProjectileSetting.ProjectileStaticMesh)
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>();
+	if (!myArchetypes)
+		return;
+
+	InitProjectileArchetype(myArchetypes->InternArchetypeByInfo(InitParam));
+	//first projectile of info is spawned before its assets are streamed, mesh and trail are set when they are
+	if (!myArchetypes->IsArchetypeLoaded(ArchetypeIndex))
+		myArchetypes->CallWhenArchetypeLoaded(ArchetypeIndex, FStreamableDelegate::CreateUObject(this, &AProjectileDefault::ArchetypeAssetsLoaded, ArchetypeIndex, TimerSerial));
+}
+
+void AProjectileDefault::ArchetypeAssetsLoaded(int32 InArchetypeIndex, uint32 InTimerSerial)
+{
+	//projectile is in pool or reused for other shot
+	if (InArchetypeIndex != ArchetypeIndex || InTimerSerial != TimerSerial)
+		return;
+
+	const FTPSProjectileArchetype* myArchetype = GetArchetype();
+	if (!myArchetype)
+		return;
+
+	InitVirtualMeshProjectile_Multicast(myArchetype->GetStaticMesh(), myArchetype->Info.ProjectileStaticMeshOffset);
+	InitVirtualTrailProjectile_Multicast(myArchetype->GetTrailFx(), myArchetype->Info.ProjectileTrailFxOffset, myArchetype->GetTracerMesh(), myArchetype->Info.TracerLength);
+}
+
+FProjectileInfo AProjectileDefault::GetProjectileInfo() const
+{
+	const FTPSProjectileArchetype* myArchetype = GetArchetype();
+	return myArchetype ? myArchetype->Info : FProjectileInfo();
+}
+
+void AProjectileDefault::InitProjectileArchetype(int32 InArchetypeIndex)
+{
+	ArchetypeIndex = InArchetypeIndex;
+	const FTPSProjectileArchetype* myArchetype = GetArchetype();
+	if (!myArchetype)
+		return;
+
+	const FProjectileInfo& myInfo = myArchetype->Info;
+	BulletProjectileMovement->InitialSpeed = myInfo.ProjectileInitSpeed;
+	BulletProjectileMovement->MaxSpeed = myInfo.ProjectileMaxSpeed;
+	if (myInfo.ProjectileLifeTime > 0.0f)
 	{
-		InitVirtualMeshProjectile_Multicast(ProjectileSetting.ProjectileStaticMesh, ProjectileSetting.ProjectileStaticMeshOffset);
+		ScheduleProjectileTimer(ETPSProjectileTimer::LifeTime, myInfo.ProjectileLifeTime);
 	}
-	else
+	//projectile can be reused from pool, so mesh and fx components are not destroyed only cleared
+	InitVirtualMeshProjectile_Multicast(myArchetype->GetStaticMesh(), myInfo.ProjectileStaticMeshOffset);
+	InitVirtualTrailProjectile_Multicast(myArchetype->GetTrailFx(), myInfo.ProjectileTrailFxOffset, myArchetype->GetTracerMesh(), myInfo.TracerLength);
+}
+
+const FTPSProjectileArchetype* AProjectileDefault::GetArchetype() const
+{
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld() ? GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>() : nullptr;
+	return myArchetypes ? myArchetypes->GetArchetype(ArchetypeIndex) : nullptr;
+}
+
+void AProjectileDefault::ImpactProjectile()
+{
+	ReleaseProjectile();
+}
+
+void AProjectileDefault::OnProjectileTimer(ETPSProjectileTimer Type)
+{
+	if (Type == ETPSProjectileTimer::LifeTime)
 	{
-		BulletMesh->DestroyComponent();
+		ReleaseProjectile();
 	}
-	if (ProjectileSetting.ProjectileTrailFx)
+}
+
+void AProjectileDefault::ScheduleProjectileTimer(ETPSProjectileTimer Type, float Delay)
+{
+	UTPSProjectileSchedulerSubsystem* myScheduler = GetWorld()->GetSubsystem<UTPSProjectileSchedulerSubsystem>();
+	if (HasAuthority() && myScheduler)
 	{
-		InitVirtualTrailProjectile_Multicast(ProjectileSetting.ProjectileTrailFx, ProjectileSetting.ProjectileTrailFxOffset);
+		myScheduler->ScheduleTimer(this, Type, Delay);
 	}
-	else
+}
+
+void AProjectileDefault::ReleaseProjectile()
+{
+	UTPSProjectilePoolSubsystem* myPool = GetWorld() ? GetWorld()->GetSubsystem<UTPSProjectilePoolSubsystem>() : nullptr;
+	if (!myPool || !myPool->ReleaseProjectile(this))
 	{
-		BulletFX->DestroyComponent();
+		this->Destroy();
 	}
 }
 
-void AProjectileDefault::ImpactProjectile()
+void AProjectileDefault::EnterPool()
+{
+	bIsInPool = true;
+	TimerSerial++;
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+
+	BulletProjectileMovement->StopMovementImmediately();
+	BulletProjectileMovement->SetComponentTickEnabled(false);
+	BulletFX->DeactivateImmediate();
+
+	ResetProjectile();
+}
+
+void AProjectileDefault::ActivateProjectile(FVector Location, FRotator Rotation, FVector Velocity)
+{
+	bIsInPool = false;
+
+	SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(true);
+
+	//projectile movement clear updated component when stop simulating
+	BulletProjectileMovement->SetUpdatedComponent(RootComponent);
+	BulletProjectileMovement->Velocity = Velocity;
+	BulletProjectileMovement->SetComponentTickEnabled(true);
+}
+
+void AProjectileDefault::ResetProjectile()
 {
-	this->Destroy();
+	ArchetypeIndex = INDEX_NONE;
+	BulletProjectileMovement->InitialSpeed = 1.f;
+	BulletProjectileMovement->MaxSpeed = 0.f;
+	BulletMesh->SetStaticMesh(nullptr);
+	BulletFX->SetTemplate(nullptr);
+	RemoveRenderInstances();
+}
+
+void AProjectileDefault::RemoveRenderInstances()
+{
+	UTPSProjectileRenderSubsystem* myRender = GetWorld() ? GetWorld()->GetSubsystem<UTPSProjectileRenderSubsystem>() : nullptr;
+	if (myRender)
+	{
+		myRender->Remove(RenderMesh);
+		myRender->Remove(RenderTracer);
+	}
+}
+
+void AProjectileDefault::DeactivateProjectile_Multicast_Implementation()
+{
+	EnterPool();
 }
 
 void AProjectileDefault::SpawnHitDecal_Multicast_Implementation(UMaterialInterface* DecalMaterial, UPrimitiveComponent* OtherComp, FHitResult HitResult)
 {
-	UGameplayStatics::SpawnDecalAttached(DecalMaterial, FVector(20.0f), OtherComp, NAME_None, HitResult.ImpactPoint, HitResult.ImpactNormal.Rotation(), EAttachLocation::KeepWorldPosition, 10.0f);
+	UTPSDecalSubsystem* myDecalSubsystem = GetWorld()->GetSubsystem<UTPSDecalSubsystem>();
+	if (myDecalSubsystem)
+	{
+		myDecalSubsystem->SpawnHitDecal(DecalMaterial, FVector(20.0f), OtherComp, HitResult.ImpactPoint, HitResult.ImpactNormal.Rotation(), UGameplayStatics::GetSurfaceType(HitResult), 10.0f);
+	}
 }
 
 void AProjectileDefault::SpawnHitFX_Multicast_Implementation(UParticleSystem* FxTemplate, FHitResult HitResult)
@@ -149,11 +282,37 @@ void AProjectileDefault::SpawnHitSound_Multicast_Implementation(USoundBase* HitS
 
 void AProjectileDefault::InitVirtualMeshProjectile_Multicast_Implementation(UStaticMesh* newMesh, FTransform MeshRelative)
 {
+	UTPSProjectileRenderSubsystem* myRender = GetWorld()->GetSubsystem<UTPSProjectileRenderSubsystem>();
+	if (newMesh && myRender && myRender->CanRender())
+	{
+		BulletMesh->SetStaticMesh(nullptr);
+		BulletMesh->SetVisibility(false);
+		myRender->AddMesh(this, newMesh, MeshRelative, RenderMesh);
+		return;
+	}
+
 	BulletMesh->SetStaticMesh(newMesh);
+	BulletMesh->SetVisibility(newMesh != nullptr);
 }
 
-void AProjectileDefault::InitVirtualTrailProjectile_Multicast_Implementation(UParticleSystem* newTemplate, FTransform TemplateRelative)
+void AProjectileDefault::InitVirtualTrailProjectile_Multicast_Implementation(UParticleSystem* newTemplate, FTransform TemplateRelative, UStaticMesh* TracerMesh, float TracerLength)
 {
-	BulletFX->SetTemplate(newTemplate);
+	UTPSProjectileRenderSubsystem* myRender = GetWorld()->GetSubsystem<UTPSProjectileRenderSubsystem>();
+	if (TracerMesh && myRender && myRender->CanRender())
+	{
+		BulletFX->DeactivateImmediate();
+		myRender->AddTracer(this, TracerMesh, TracerLength, RenderTracer);
+		return;
+	}
+
+	if (newTemplate)
+	{
+		BulletFX->SetTemplate(newTemplate);
+		BulletFX->Activate(true);
+	}
+	else
+	{
+		BulletFX->DeactivateImmediate();
+	}
 }
 
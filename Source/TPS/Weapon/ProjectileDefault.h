@@ -7,6 +7,8 @@
 #include "GameFramework/ProjectileMovementComponent.h"
 
 #include "../FuncLibrary/Types.h"
+#include "TPSProjectileSchedulerSubsystem.h"
+#include "TPSProjectileRenderSubsystem.h"
 #include "ProjectileDefault.generated.h"
 
 UCLASS()
@@ -26,17 +28,19 @@ public:
 	class UProjectileMovementComponent* BulletProjectileMovement = nullptr;
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"), Category = Components)
 	class UParticleSystemComponent* BulletFX = nullptr;
-	UPROPERTY(BlueprintReadOnly)
-	FProjectileInfo ProjectileSetting;
+	//shared setting of weapon in UTPSProjectileArchetypeSubsystem, INDEX_NONE in pool
+	int32 ArchetypeIndex = INDEX_NONE;
+	const FTPSProjectileArchetype* GetArchetype() const;
+	//instances in UTPSProjectileRenderSubsystem, used instead of BulletMesh and BulletFX
+	FTPSProjectileRenderHandle RenderMesh;
+	FTPSProjectileRenderHandle RenderTracer;
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	UFUNCTION()
 	virtual void BulletCollisionSphereHit(class UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 	UFUNCTION()
@@ -44,15 +48,43 @@ public:
 	UFUNCTION()
 	void BulletCollisionSphereEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
 
+	void InitProjectileArchetype(int32 InArchetypeIndex);
+	//for projectile spawned by blueprint, same info share one archetype
 	UFUNCTION(BlueprintCallable)
 	void InitProjectile(FProjectileInfo InitParam);
+	void ArchetypeAssetsLoaded(int32 InArchetypeIndex, uint32 InTimerSerial);
+	UFUNCTION(BlueprintPure)
+	FProjectileInfo GetProjectileInfo() const;
 	UFUNCTION()
 	virtual void ImpactProjectile();
 
+	//life time and fuse are in UTPSProjectileSchedulerSubsystem on server
+	virtual void OnProjectileTimer(ETPSProjectileTimer Type);
+	void ScheduleProjectileTimer(ETPSProjectileTimer Type, float Delay);
+	//changed when projectile leave or enter pool, scheduled timers of previous shot are ignored
+	uint32 TimerSerial = 0;
+
+	//Pool
+	//return projectile to pool, destroy if pool can't take it
+	void ReleaseProjectile();
+	//local state on every machine
+	void EnterPool();
+	void ActivateProjectile(FVector Location, FRotator Rotation, FVector Velocity);
+	//clear state from previous shot
+	virtual void ResetProjectile();
+	void RemoveRenderInstances();
+
+	bool bIsInPool = false;
+	//client local copy of server projectile, not replicated, only visual
+	bool bCosmetic = false;
+
+	UFUNCTION(NetMulticast, Reliable)
+	void DeactivateProjectile_Multicast();
+
 	UFUNCTION(NetMulticast, Reliable)
 	void InitVirtualMeshProjectile_Multicast(UStaticMesh* newMesh, FTransform MeshRelative);
 	UFUNCTION(NetMulticast, Reliable)
-	void InitVirtualTrailProjectile_Multicast(UParticleSystem* newTemplate, FTransform TemplateRelative);
+	void InitVirtualTrailProjectile_Multicast(UParticleSystem* newTemplate, FTransform TemplateRelative, UStaticMesh* TracerMesh, float TracerLength);
 	UFUNCTION(NetMulticast, Reliable)
 	void SpawnHitDecal_Multicast(UMaterialInterface* DecalMaterial, UPrimitiveComponent* OtherComp, FHitResult HitResult);
 	UFUNCTION(NetMulticast, Reliable)
@@ -4,6 +4,7 @@
 #include "ProjectileDefault_Grenade.h"
 #include "Kismet/GameplayStatics.h"
 #include "DrawDebugHelpers.h"
+#include "TPSExplosionSubsystem.h"
 
 int32 DebugExplodeShow = 0;
 FAutoConsoleVariableRef CVARExplodeShow{
@@ -18,84 +19,90 @@ void AProjectileDefault_Grenade::BeginPlay()
 	Super::BeginPlay();
 }
 
-void AProjectileDefault_Grenade::Tick(float DeltaTime)
+void AProjectileDefault_Grenade::BulletCollisionSphereHit(class UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
-	Super::Tick(DeltaTime);
-	TimerExplode_OnServer(DeltaTime);
+	Super::BulletCollisionSphereHit(HitComp, OtherActor, OtherComp, NormalImpulse, Hit);
 }
 
-void AProjectileDefault_Grenade::TimerExplode_OnServer_Implementation(float DeltaTime)
+void AProjectileDefault_Grenade::ImpactProjectile()
 {
-	if (TimerEnabled)
+	//Init Grenade, fuse is not restarted by next bounces
+	if (!TimerEnabled)
 	{
-		if (TimerToExplose > TimeToExplose)
-		{
-			//Explode
-			Explode();
-		}
-		else
-		{
-			TimerToExplose += DeltaTime;
-		}
+		TimerEnabled = true;
+		ScheduleProjectileTimer(ETPSProjectileTimer::Fuse, TimeToExplose);
 	}
 }
 
-void AProjectileDefault_Grenade::BulletCollisionSphereHit(class UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+void AProjectileDefault_Grenade::ResetProjectile()
 {
-	Super::BulletCollisionSphereHit(HitComp, OtherActor, OtherComp, NormalImpulse, Hit);
+	Super::ResetProjectile();
+
+	TimerEnabled = false;
 }
 
-void AProjectileDefault_Grenade::ImpactProjectile()
+void AProjectileDefault_Grenade::OnProjectileTimer(ETPSProjectileTimer Type)
 {
-	//Init Grenade
-	TimerEnabled = true;
+	if (Type == ETPSProjectileTimer::Fuse)
+	{
+		Explode();
+	}
+	else
+	{
+		Super::OnProjectileTimer(Type);
+	}
 }
 
 void AProjectileDefault_Grenade::Explode()
 {
-	FHitResult Hit;
+	TimerEnabled = false;
+	const FTPSProjectileArchetype* myArchetype = GetArchetype();
+	if (!myArchetype)
+	{
+		ReleaseProjectile();
+		return;
+	}
+
+	const FProjectileInfo& myInfo = myArchetype->Info;
 	if (DebugExplodeShow)
 	{
-		DrawDebugSphere(GetWorld(), GetActorLocation(), ProjectileSetting.ProjectileMinRadiusDamage, 12, FColor::Green, false, 12.0f);
-		DrawDebugSphere(GetWorld(), GetActorLocation(), ProjectileSetting.ProjectileMaxRadiusDamage, 12, FColor::Red, false, 12.0f);
+		DrawDebugSphere(GetWorld(), GetActorLocation(), myInfo.ProjectileMinRadiusDamage, 12, FColor::Green, false, 12.0f);
+		DrawDebugSphere(GetWorld(), GetActorLocation(), myInfo.ProjectileMaxRadiusDamage, 12, FColor::Red, false, 12.0f);
 	}
-	TimerEnabled = false;
-	if (ProjectileSetting.ExploseFX)
+	UParticleSystem* myExploseFX = myArchetype->GetExploseFX();
+	if (myExploseFX)
 	{
-		GrenadeHitFX_Multicast(ProjectileSetting.ExploseFX, GetActorLocation(), GetActorRotation());
-		float a = GetActorLocation().X;
-		float b = GetActorLocation().Y;
-		float c = GetActorLocation().Z;
-		TArray<float> arr = {a, b, c};
-		FString TEXT = "GrenadeLocation";
-		OnScreenMessage_Multicast(arr, 3, TEXT);
+		GrenadeHitFX_Multicast(myExploseFX, GetActorLocation(), GetActorRotation());
 	}
-	if (ProjectileSetting.ExploseSound)
+	USoundBase* myExploseSound = myArchetype->GetExploseSound();
+	if (myExploseSound)
 	{
-		GrenadeHitSound_Multicast(ProjectileSetting.ExploseSound, GetActorLocation());
+		GrenadeHitSound_Multicast(myExploseSound, GetActorLocation());
 	}
-	TArray<AActor*> IgnoredActor;
-	UGameplayStatics::ApplyRadialDamageWithFalloff(GetWorld(),
-		ProjectileSetting.ExplodeMaxDamage,
-		ProjectileSetting.ExplodeMaxDamage * 0.2f,
-		GetActorLocation(),
-		ProjectileSetting.ProjectileMinRadiusDamage,
-		ProjectileSetting.ProjectileMaxRadiusDamage,
-		5,
-		UDamageType::StaticClass(), IgnoredActor, this, nullptr);
-
-	this->Destroy();
-}
-
-void AProjectileDefault_Grenade::OnScreenMessage_Multicast_Implementation(const TArray<float> &a, float len, const FString &ShowText)
-{
-	//For Testing Multicast
-	//GEngine->AddOnScreenDebugMessage(1, 4.0f, FColor::Red, FString::Printf(TEXT("Array lenght: %i"), sizeof(a)));
-	for (int i = 0; i < len; i++)
+	UTPSExplosionSubsystem* myExplosions = GetWorld()->GetSubsystem<UTPSExplosionSubsystem>();
+	if (myExplosions)
 	{
-		GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("%s: %f"), *ShowText, a[i]));
+		FTPSPendingExplosion Explosion;
+		Explosion.Origin = GetActorLocation();
+		Explosion.BaseDamage = myInfo.ExplodeMaxDamage;
+		Explosion.MinimumDamage = myInfo.ExplodeMaxDamage * 0.2f;
+		Explosion.InnerRadius = myInfo.ProjectileMinRadiusDamage;
+		Explosion.OuterRadius = myInfo.ProjectileMaxRadiusDamage;
+		Explosion.DamageFalloff = 5;
+		Explosion.DamageTypeClass = UDamageType::StaticClass();
+		Explosion.DamageCauser = this;
+		Explosion.bReleaseCauser = true;
+		Explosion.CauserSerial = TimerSerial;
+
+		//stay out of world until subsystem apply damage and release it
+		SetActorHiddenInGame(true);
+		SetActorEnableCollision(false);
+		BulletProjectileMovement->StopMovementImmediately();
+		myExplosions->QueueExplosion(Explosion);
+		return;
 	}
-	GEngine->AddOnScreenDebugMessage(-1, 2.0f, FColor::Red, FString::Printf(TEXT("//////")));
+
+	ReleaseProjectile();
 }
 
 void AProjectileDefault_Grenade::GrenadeHitFX_Multicast_Implementation(UParticleSystem* FxTemplate, FVector Location, FRotator Rotation)
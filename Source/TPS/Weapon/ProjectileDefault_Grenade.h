@@ -20,21 +20,16 @@ protected:
 	virtual void BeginPlay() override;
 
 public:
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-	UFUNCTION(Server, Reliable)
-	void TimerExplode_OnServer(float DeltaTime);
-
 	virtual void BulletCollisionSphereHit(class UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit) override;
 	
 	virtual void ImpactProjectile() override;
+	virtual void ResetProjectile() override;
+	virtual void OnProjectileTimer(ETPSProjectileTimer Type) override;
 
 	UFUNCTION()
 	void Explode();
 
-	//UPROPERTY(Replicated)
-	float TimerToExplose = 0.0f;
-
+	//fuse is scheduled, set on first impact
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grenade")
 	bool TimerEnabled = false;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grenade")
@@ -43,6 +38,4 @@ public:
 	void GrenadeHitFX_Multicast(UParticleSystem* FxTemplate, FVector Location, FRotator Rotation);
 	UFUNCTION(NetMulticast, Reliable)
 	void GrenadeHitSound_Multicast(USoundBase* HitSound, FVector Location);
-	UFUNCTION(NetMulticast, Reliable)
-	void OnScreenMessage_Multicast(const TArray<float> &a, float len, const FString &ShowText);
 };
@@ -0,0 +1,313 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSDecalSubsystem.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "Components/DecalComponent.h"
+#include "../TPS.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Decals Live"), STAT_TPS_DecalsLive, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Decals Merged"), STAT_TPS_DecalsMerged, STATGROUP_TPS);
+
+int32 DecalMaxTotal = 128;
+FAutoConsoleVariableRef CVarDecalMaxTotal(
+	TEXT("TPS.Decal.MaxTotal"),
+	DecalMaxTotal,
+	TEXT("Max hit decals of all surfaces, oldest fade out when reached"),
+	ECVF_Default);
+
+int32 DecalMaxPerSurface = 48;
+FAutoConsoleVariableRef CVarDecalMaxPerSurface(
+	TEXT("TPS.Decal.MaxPerSurface"),
+	DecalMaxPerSurface,
+	TEXT("Max hit decals of one surface type"),
+	ECVF_Default);
+
+float DecalMergeRadius = 8.0f;
+FAutoConsoleVariableRef CVarDecalMergeRadius(
+	TEXT("TPS.Decal.MergeRadius"),
+	DecalMergeRadius,
+	TEXT("Hit closer than this to decal with same material on same component refresh it instead of new decal"),
+	ECVF_Default);
+
+float DecalFadeTime = 1.0f;
+FAutoConsoleVariableRef CVarDecalFadeTime(
+	TEXT("TPS.Decal.FadeTime"),
+	DecalFadeTime,
+	TEXT("Fade out time of pushed out or expired decal"),
+	ECVF_Default);
+
+void UTPSDecalSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SurfaceRings.SetNum(SurfaceType_Max);
+}
+
+void UTPSDecalSubsystem::Deinitialize()
+{
+	if (GetWorld())
+		GetWorld()->GetTimerManager().ClearTimer(ExpireTimer);
+	NextExpireTime = MAX_flt;
+
+	DEC_DWORD_STAT_BY(STAT_TPS_DecalsLive, LiveDecals);
+	LiveDecals = 0;
+	TotalDecals = 0;
+
+	SurfaceRings.Empty();
+	FadingDecals.Empty();
+	FreeDecals.Empty();
+	DecalsHolder = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UTPSDecalSubsystem::SpawnHitDecal(UMaterialInterface* DecalMaterial, FVector DecalSize, UPrimitiveComponent* AttachComponent, const FVector& Location, const FRotator& Rotation, EPhysicalSurface SurfaceType, float LifeTime)
+{
+	UWorld* myWorld = GetWorld();
+	if (!DecalMaterial || !myWorld || myWorld->GetNetMode() == NM_DedicatedServer || !SurfaceRings.IsValidIndex(SurfaceType))
+		return;
+
+	const float Now = myWorld->GetTimeSeconds();
+	FTPSDecalRing& Ring = SurfaceRings[SurfaceType];
+
+	RemoveExpired(Ring, Now);
+
+	//decal without component is attached to holder
+	USceneComponent* myParent = AttachComponent;
+	if (!myParent && DecalsHolder)
+		myParent = DecalsHolder->GetRootComponent();
+
+	if (myParent && TryMergeDecal(Ring, DecalMaterial, myParent, Location, LifeTime, Now))
+		return;
+
+	UDecalComponent* myDecal = AcquireDecal(Now);
+	if (!myDecal)
+		return;
+	if (!myParent)
+		myParent = DecalsHolder->GetRootComponent();
+
+	const int32 Capacity = FMath::Max(DecalMaxPerSurface, 1);
+	if (Ring.Count >= Capacity)
+	{
+		RemoveOldest(Ring, Now, true);
+	}
+	while (TotalDecals > 0 && TotalDecals >= DecalMaxTotal)
+	{
+		FTPSDecalRing* OldestRing = nullptr;
+		for (FTPSDecalRing& OtherRing : SurfaceRings)
+		{
+			if (OtherRing.Count > 0 && (!OldestRing || OtherRing.Serials[GetOldestIndex(OtherRing)] < OldestRing->Serials[GetOldestIndex(*OldestRing)]))
+				OldestRing = &OtherRing;
+		}
+		if (!OldestRing)
+			break;
+		RemoveOldest(*OldestRing, Now, true);
+	}
+
+	myDecal->SetDecalMaterial(DecalMaterial);
+	myDecal->DecalSize = DecalSize;
+	myDecal->AttachToComponent(myParent, FAttachmentTransformRules::KeepWorldTransform);
+	myDecal->SetWorldLocationAndRotation(Location, Rotation);
+	if (LifeTime > 0.0f)
+		SetDecalFade(myDecal, LifeTime, DecalFadeTime);
+	else
+		SetDecalFade(myDecal, 0.0f, 0.0f);
+	myDecal->SetVisibility(true);
+
+	if (Ring.Head >= Capacity)
+		Ring.Head = 0;
+
+	if (Ring.Head >= Ring.Decals.Num())
+	{
+		Ring.Decals.Add(myDecal);
+		Ring.Serials.Add(NextSerial);
+		Ring.ExpireTime.Add(0.0f);
+	}
+	else
+	{
+		Ring.Decals[Ring.Head] = myDecal;
+		Ring.Serials[Ring.Head] = NextSerial;
+	}
+	Ring.ExpireTime[Ring.Head] = LifeTime > 0.0f ? Now + LifeTime + DecalFadeTime : MAX_flt;
+	ScheduleExpire(Ring.ExpireTime[Ring.Head], Now);
+
+	Ring.Head = (Ring.Head + 1) % Capacity;
+	Ring.Count++;
+	TotalDecals++;
+	NextSerial++;
+}
+
+UDecalComponent* UTPSDecalSubsystem::AcquireDecal(float Now)
+{
+	//fade time is same for all, so first one end fade first
+	int32 FadeEnded = 0;
+	while (FadeEnded < FadingDecals.Num() && FadingDecals[FadeEnded].FreeTime <= Now)
+	{
+		ReleaseDecal(FadingDecals[FadeEnded].Decal);
+		FadeEnded++;
+	}
+	if (FadeEnded > 0)
+		FadingDecals.RemoveAt(0, FadeEnded, false);
+
+	while (FreeDecals.Num() > 0)
+	{
+		UDecalComponent* myDecal = FreeDecals.Pop(false);
+		if (IsValid(myDecal))
+		{
+			LiveDecals++;
+			INC_DWORD_STAT(STAT_TPS_DecalsLive);
+			return myDecal;
+		}
+	}
+
+	if (!DecalsHolder)
+	{
+		FActorSpawnParameters Param;
+		Param.ObjectFlags |= RF_Transient;
+		DecalsHolder = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, Param);
+		if (!DecalsHolder)
+			return nullptr;
+
+		USceneComponent* myRoot = NewObject<USceneComponent>(DecalsHolder, TEXT("Root"));
+		DecalsHolder->SetRootComponent(myRoot);
+		myRoot->RegisterComponent();
+	}
+
+	UDecalComponent* NewDecal = NewObject<UDecalComponent>(DecalsHolder);
+	NewDecal->SetUsingAbsoluteScale(true);
+	NewDecal->SetupAttachment(DecalsHolder->GetRootComponent());
+	NewDecal->RegisterComponent();
+
+	LiveDecals++;
+	INC_DWORD_STAT(STAT_TPS_DecalsLive);
+	return NewDecal;
+}
+
+void UTPSDecalSubsystem::ReleaseDecal(UDecalComponent* Decal)
+{
+	LiveDecals--;
+	DEC_DWORD_STAT(STAT_TPS_DecalsLive);
+	if (!IsValid(Decal))
+		return;
+
+	Decal->SetVisibility(false);
+	if (DecalsHolder && Decal->GetAttachParent() != DecalsHolder->GetRootComponent())
+	{
+		Decal->AttachToComponent(DecalsHolder->GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
+	}
+	FreeDecals.Add(Decal);
+}
+
+void UTPSDecalSubsystem::SetDecalFade(UDecalComponent* Decal, float StartDelay, float Duration)
+{
+	//proxy take fade start from its creation time
+	Decal->FadeStartDelay = StartDelay;
+	Decal->FadeDuration = Duration;
+	Decal->MarkRenderStateDirty();
+}
+
+void UTPSDecalSubsystem::ScheduleExpire(float ExpireTime, float Now)
+{
+	if (ExpireTime >= NextExpireTime || ExpireTime == MAX_flt)
+		return;
+
+	NextExpireTime = ExpireTime;
+	GetWorld()->GetTimerManager().SetTimer(ExpireTimer, this, &UTPSDecalSubsystem::OnExpireTimer, FMath::Max(ExpireTime - Now, KINDA_SMALL_NUMBER), false);
+}
+
+void UTPSDecalSubsystem::OnExpireTimer()
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	NextExpireTime = MAX_flt;
+
+	int32 FadeEnded = 0;
+	while (FadeEnded < FadingDecals.Num() && FadingDecals[FadeEnded].FreeTime <= Now)
+	{
+		ReleaseDecal(FadingDecals[FadeEnded].Decal);
+		FadeEnded++;
+	}
+	if (FadeEnded > 0)
+		FadingDecals.RemoveAt(0, FadeEnded, false);
+
+	float NextTime = FadingDecals.Num() > 0 ? FadingDecals[0].FreeTime : MAX_flt;
+	for (FTPSDecalRing& Ring : SurfaceRings)
+	{
+		RemoveExpired(Ring, Now);
+
+		//ring expire from oldest, same as RemoveExpired
+		if (Ring.Count > 0)
+			NextTime = FMath::Min(NextTime, Ring.ExpireTime[GetOldestIndex(Ring)]);
+	}
+	ScheduleExpire(NextTime, Now);
+}
+
+void UTPSDecalSubsystem::RemoveOldest(FTPSDecalRing& Ring, float Now, bool bFade)
+{
+	const int32 Oldest = GetOldestIndex(Ring);
+	UDecalComponent* myDecal = Ring.Decals[Oldest];
+	Ring.Decals[Oldest] = nullptr;
+	Ring.Count--;
+	TotalDecals--;
+
+	if (bFade && DecalFadeTime > 0.0f && IsValid(myDecal))
+	{
+		SetDecalFade(myDecal, 0.0f, DecalFadeTime);
+
+		FTPSFadingDecal NewFading;
+		NewFading.Decal = myDecal;
+		NewFading.FreeTime = Now + DecalFadeTime;
+		FadingDecals.Add(NewFading);
+		ScheduleExpire(NewFading.FreeTime, Now);
+	}
+	else
+	{
+		ReleaseDecal(myDecal);
+	}
+}
+
+void UTPSDecalSubsystem::RemoveExpired(FTPSDecalRing& Ring, float Now)
+{
+	//decal with lifetime already faded
+	while (Ring.Count > 0 && Ring.ExpireTime[GetOldestIndex(Ring)] <= Now)
+	{
+		RemoveOldest(Ring, Now, false);
+	}
+}
+
+bool UTPSDecalSubsystem::TryMergeDecal(FTPSDecalRing& Ring, UMaterialInterface* DecalMaterial, USceneComponent* AttachComponent, const FVector& Location, float LifeTime, float Now)
+{
+	if (DecalMergeRadius <= 0.0f)
+		return false;
+
+	const float MergeRadiusSq = FMath::Square(DecalMergeRadius);
+	const int32 Num = Ring.Decals.Num();
+	for (int32 i = 0; i < Ring.Count; i++)
+	{
+		const int32 Index = (Ring.Head - Ring.Count + i + Num) % Num;
+		UDecalComponent* myDecal = Ring.Decals[Index];
+		if (IsValid(myDecal)
+			&& myDecal->GetAttachParent() == AttachComponent
+			&& myDecal->GetDecalMaterial() == DecalMaterial
+			&& FVector::DistSquared(myDecal->GetComponentLocation(), Location) <= MergeRadiusSq)
+		{
+			//keep it visible as long as new decal would be
+			if (LifeTime > 0.0f)
+			{
+				SetDecalFade(myDecal, LifeTime, DecalFadeTime);
+				Ring.ExpireTime[Index] = FMath::Max(Ring.ExpireTime[Index], Now + LifeTime + DecalFadeTime);
+				ScheduleExpire(Ring.ExpireTime[Index], Now);
+			}
+			INC_DWORD_STAT(STAT_TPS_DecalsMerged);
+			return true;
+		}
+	}
+	return false;
+}
+
+int32 UTPSDecalSubsystem::GetOldestIndex(const FTPSDecalRing& Ring) const
+{
+	const int32 Num = Ring.Decals.Num();
+	return (Ring.Head - Ring.Count + Num) % Num;
+}
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSDecalSubsystem.generated.h"
+
+class UDecalComponent;
+
+//decals of one surface type, oldest first from Head - Count
+USTRUCT()
+struct FTPSDecalRing
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UDecalComponent*> Decals;
+
+	//spawn order, for find oldest decal between all surfaces
+	TArray<uint32> Serials;
+	TArray<float> ExpireTime;
+	int32 Head = 0;
+	int32 Count = 0;
+};
+
+//decal waiting end of fade before reuse
+USTRUCT()
+struct FTPSFadingDecal
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UDecalComponent* Decal = nullptr;
+
+	float FreeTime = 0.0f;
+};
+
+/**
+ * Hit decals budget. Decal components are reused, every surface type have own cap and all surfaces have global cap,
+ * when cap is reached oldest decal fade out. Decal close to existing one on same component only refresh existing.
+ */
+UCLASS()
+class TPS_API UTPSDecalSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//LifeTime <= 0 - decal stay until it is pushed out by cap
+	void SpawnHitDecal(UMaterialInterface* DecalMaterial, FVector DecalSize, UPrimitiveComponent* AttachComponent, const FVector& Location, const FRotator& Rotation, EPhysicalSurface SurfaceType, float LifeTime);
+
+	UFUNCTION(BlueprintCallable, Category = "Decal")
+	int32 GetLiveDecalsNum() const { return LiveDecals; }
+
+protected:
+	UDecalComponent* AcquireDecal(float Now);
+	void ReleaseDecal(UDecalComponent* Decal);
+	//fade of pooled decal, component SetFadeOut would destroy it at end of fade
+	static void SetDecalFade(UDecalComponent* Decal, float StartDelay, float Duration);
+	void ScheduleExpire(float ExpireTime, float Now);
+	void OnExpireTimer();
+	void RemoveOldest(FTPSDecalRing& Ring, float Now, bool bFade);
+	void RemoveExpired(FTPSDecalRing& Ring, float Now);
+	bool TryMergeDecal(FTPSDecalRing& Ring, UMaterialInterface* DecalMaterial, USceneComponent* AttachComponent, const FVector& Location, float LifeTime, float Now);
+	int32 GetOldestIndex(const FTPSDecalRing& Ring) const;
+
+	UPROPERTY()
+	AActor* DecalsHolder = nullptr;
+	//by EPhysicalSurface
+	UPROPERTY()
+	TArray<FTPSDecalRing> SurfaceRings;
+	UPROPERTY()
+	TArray<FTPSFadingDecal> FadingDecals;
+	UPROPERTY()
+	TArray<UDecalComponent*> FreeDecals;
+
+	FTimerHandle ExpireTimer;
+	float NextExpireTime = MAX_flt;
+
+	int32 TotalDecals = 0;
+	int32 LiveDecals = 0;
+	uint32 NextSerial = 0;
+};
@@ -0,0 +1,280 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSDropMeshSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("DropMesh Tick"), STAT_TPS_DropMeshTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("DropMesh Simulating"), STAT_TPS_DropMeshSimulating, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("DropMesh Instances"), STAT_TPS_DropMeshInstances, STATGROUP_TPS);
+
+int32 DropMeshMaxSimulating = 16;
+FAutoConsoleVariableRef CVarDropMeshMaxSimulating(
+	TEXT("TPS.DropMesh.MaxSimulating"),
+	DropMeshMaxSimulating,
+	TEXT("Max shells and clips simulate physics at same time, oldest is settled when new one dropped"),
+	ECVF_Default);
+
+int32 DropMeshMaxInstances = 64;
+FAutoConsoleVariableRef CVarDropMeshMaxInstances(
+	TEXT("TPS.DropMesh.MaxInstances"),
+	DropMeshMaxInstances,
+	TEXT("Capacity of settled instances for one drop mesh, oldest is reused when full"),
+	ECVF_Default);
+
+float DropMeshMaxSimulateTime = 2.0f;
+FAutoConsoleVariableRef CVarDropMeshMaxSimulateTime(
+	TEXT("TPS.DropMesh.MaxSimulateTime"),
+	DropMeshMaxSimulateTime,
+	TEXT("Time after which dropped mesh is settled even if body is still awake"),
+	ECVF_Default);
+
+void UTPSDropMeshSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_DropMeshSimulating, SimulatingBodies.Num());
+	for (TPair<UStaticMesh*, FTPSDropMeshRing>& Ring : Rings)
+	{
+		DEC_DWORD_STAT_BY(STAT_TPS_DropMeshInstances, Ring.Value.Count);
+	}
+
+	SimulatingBodies.Empty();
+	FreeBodies.Empty();
+	Rings.Empty();
+	InstancesHolder = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UTPSDropMeshSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_DropMeshTick);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	for (int32 i = SimulatingBodies.Num() - 1; i >= 0; i--)
+	{
+		const FTPSDropMeshBody& Body = SimulatingBodies[i];
+		if (!IsValid(Body.Actor))
+		{
+			SimulatingBodies.RemoveAt(i);
+			DEC_DWORD_STAT(STAT_TPS_DropMeshSimulating);
+			continue;
+		}
+
+		const float SimulateTime = Now - Body.StartTime;
+		//give impulse at least one physics step before check sleep
+		if (SimulateTime > DropMeshMaxSimulateTime
+			|| (SimulateTime > 0.1f && !Body.Actor->GetStaticMeshComponent()->IsAnyRigidBodyAwake()))
+		{
+			SettleBody(i);
+		}
+	}
+
+	for (TPair<UStaticMesh*, FTPSDropMeshRing>& Ring : Rings)
+	{
+		ExpireInstances(Ring.Value, Now);
+	}
+}
+
+bool UTPSDropMeshSubsystem::IsTickable() const
+{
+	return SimulatingBodies.Num() > 0 || Rings.Num() > 0;
+}
+
+ETickableTickType UTPSDropMeshSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSDropMeshSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSDropMeshSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSDropMeshSubsystem::SpawnDropMesh(UStaticMesh* DropMesh, const FTransform& Transform, FVector Impulse, float LifeTime, float CustomMass)
+{
+	UWorld* myWorld = GetWorld();
+	//nobody see shells on dedicated server
+	if (!DropMesh || !myWorld || !myWorld->IsGameWorld() || myWorld->GetNetMode() == NM_DedicatedServer)
+		return;
+
+	//budget is full, oldest body go to instances
+	while (SimulatingBodies.Num() > 0 && SimulatingBodies.Num() >= DropMeshMaxSimulating)
+	{
+		SettleBody(0);
+	}
+
+	const float Now = myWorld->GetTimeSeconds();
+
+	if (DropMeshMaxSimulating <= 0)
+	{
+		AddSettledInstance(GetRing(DropMesh), Transform, LifeTime > 0.0f ? Now + LifeTime : MAX_flt);
+		return;
+	}
+
+	AStaticMeshActor* myBody = GetFreeBody();
+	if (!myBody)
+		return;
+
+	UStaticMeshComponent* myMesh = myBody->GetStaticMeshComponent();
+	myMesh->SetStaticMesh(DropMesh);
+	myBody->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+	myBody->SetActorHiddenInGame(false);
+	myBody->SetActorEnableCollision(true);
+	myMesh->SetSimulatePhysics(true);
+
+	if (CustomMass > 0.0f)
+		myMesh->SetMassOverrideInKg(NAME_None, CustomMass, true);
+	else
+		myMesh->SetMassOverrideInKg(NAME_None, 0.0f, false);
+
+	if (!Impulse.IsNearlyZero())
+		myMesh->AddImpulse(Impulse);
+
+	FTPSDropMeshBody NewBody;
+	NewBody.Actor = myBody;
+	NewBody.DropMesh = DropMesh;
+	NewBody.StartTime = Now;
+	NewBody.LifeTime = LifeTime;
+	SimulatingBodies.Add(NewBody);
+	INC_DWORD_STAT(STAT_TPS_DropMeshSimulating);
+}
+
+AStaticMeshActor* UTPSDropMeshSubsystem::GetFreeBody()
+{
+	while (FreeBodies.Num() > 0)
+	{
+		AStaticMeshActor* myBody = FreeBodies.Pop(false);
+		if (IsValid(myBody))
+			return myBody;
+	}
+
+	FActorSpawnParameters Param;
+	Param.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	Param.ObjectFlags |= RF_Transient;
+
+	AStaticMeshActor* NewBody = GetWorld()->SpawnActor<AStaticMeshActor>(AStaticMeshActor::StaticClass(), FTransform::Identity, Param);
+	if (NewBody && NewBody->GetStaticMeshComponent())
+	{
+		UStaticMeshComponent* myMesh = NewBody->GetStaticMeshComponent();
+		myMesh->SetMobility(EComponentMobility::Movable);
+		myMesh->SetCollisionProfileName(TEXT("IgnoreOnlyPawn"));
+		myMesh->SetCollisionEnabled(ECollisionEnabled::PhysicsOnly);
+
+		myMesh->SetCollisionResponseToChannel(ECC_GameTraceChannel1, ECollisionResponse::ECR_Ignore);
+		myMesh->SetCollisionResponseToChannel(ECC_GameTraceChannel2, ECollisionResponse::ECR_Ignore);
+		myMesh->SetCollisionResponseToChannel(ECC_Pawn, ECollisionResponse::ECR_Ignore);
+		myMesh->SetCollisionResponseToChannel(ECC_WorldStatic, ECollisionResponse::ECR_Block);
+		myMesh->SetCollisionResponseToChannel(ECC_WorldDynamic, ECollisionResponse::ECR_Block);
+		myMesh->SetCollisionResponseToChannel(ECC_PhysicsBody, ECollisionResponse::ECR_Block);
+		return NewBody;
+	}
+
+	return nullptr;
+}
+
+void UTPSDropMeshSubsystem::SettleBody(int32 BodyIndex)
+{
+	FTPSDropMeshBody Body = SimulatingBodies[BodyIndex];
+	SimulatingBodies.RemoveAt(BodyIndex);
+	DEC_DWORD_STAT(STAT_TPS_DropMeshSimulating);
+
+	if (!IsValid(Body.Actor))
+		return;
+
+	UStaticMeshComponent* myMesh = Body.Actor->GetStaticMeshComponent();
+	const float ExpireTime = Body.LifeTime > 0.0f ? Body.StartTime + Body.LifeTime : MAX_flt;
+	if (Body.DropMesh && ExpireTime > GetWorld()->GetTimeSeconds())
+	{
+		AddSettledInstance(GetRing(Body.DropMesh), myMesh->GetComponentTransform(), ExpireTime);
+	}
+
+	myMesh->SetSimulatePhysics(false);
+	Body.Actor->SetActorEnableCollision(false);
+	Body.Actor->SetActorHiddenInGame(true);
+	FreeBodies.Add(Body.Actor);
+}
+
+FTPSDropMeshRing& UTPSDropMeshSubsystem::GetRing(UStaticMesh* DropMesh)
+{
+	FTPSDropMeshRing& Ring = Rings.FindOrAdd(DropMesh);
+	if (!Ring.Instances)
+	{
+		if (!InstancesHolder)
+		{
+			FActorSpawnParameters Param;
+			Param.ObjectFlags |= RF_Transient;
+			InstancesHolder = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, Param);
+
+			USceneComponent* myRoot = NewObject<USceneComponent>(InstancesHolder, TEXT("Root"));
+			InstancesHolder->SetRootComponent(myRoot);
+			myRoot->RegisterComponent();
+		}
+
+		Ring.Instances = NewObject<UInstancedStaticMeshComponent>(InstancesHolder);
+		Ring.Instances->SetMobility(EComponentMobility::Movable);
+		Ring.Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Ring.Instances->SetGenerateOverlapEvents(false);
+		Ring.Instances->SetStaticMesh(DropMesh);
+		Ring.Instances->SetupAttachment(InstancesHolder->GetRootComponent());
+		Ring.Instances->RegisterComponent();
+	}
+	return Ring;
+}
+
+void UTPSDropMeshSubsystem::AddSettledInstance(FTPSDropMeshRing& Ring, const FTransform& Transform, float ExpireTime)
+{
+	const int32 Capacity = FMath::Max(DropMeshMaxInstances, 1);
+
+	if (Ring.Head >= Capacity)
+		Ring.Head = 0;
+
+	if (Ring.Head >= Ring.Instances->GetInstanceCount())
+	{
+		Ring.Instances->AddInstanceWorldSpace(Transform);
+		Ring.ExpireTime.Add(ExpireTime);
+	}
+	else
+	{
+		Ring.Instances->UpdateInstanceTransform(Ring.Head, Transform, true, true, true);
+		Ring.ExpireTime[Ring.Head] = ExpireTime;
+	}
+
+	Ring.Head = (Ring.Head + 1) % Capacity;
+	if (Ring.Count < FMath::Min(Capacity, Ring.ExpireTime.Num()))
+	{
+		Ring.Count++;
+		INC_DWORD_STAT(STAT_TPS_DropMeshInstances);
+	}
+}
+
+void UTPSDropMeshSubsystem::ExpireInstances(FTPSDropMeshRing& Ring, float Now)
+{
+	const int32 Num = Ring.ExpireTime.Num();
+	if (Num == 0)
+		return;
+
+	//instances are written in order, so oldest is always Count behind Head
+	bool bDirty = false;
+	while (Ring.Count > 0)
+	{
+		const int32 Oldest = (Ring.Head - Ring.Count + Num) % Num;
+		if (Ring.ExpireTime[Oldest] > Now)
+			break;
+
+		FTransform Hidden;
+		Ring.Instances->GetInstanceTransform(Oldest, Hidden, false);
+		Hidden.SetScale3D(FVector::ZeroVector);
+		Ring.Instances->UpdateInstanceTransform(Oldest, Hidden, false, false, true);
+
+		Ring.Count--;
+		DEC_DWORD_STAT(STAT_TPS_DropMeshInstances);
+		bDirty = true;
+	}
+
+	if (bDirty)
+		Ring.Instances->MarkRenderStateDirty();
+}
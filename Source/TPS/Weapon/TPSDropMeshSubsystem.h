@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSDropMeshSubsystem.generated.h"
+
+class AStaticMeshActor;
+class UInstancedStaticMeshComponent;
+
+//settled shells or clips of one DropMesh, fixed capacity ring buffer of instances
+USTRUCT()
+struct FTPSDropMeshRing
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UInstancedStaticMeshComponent* Instances = nullptr;
+
+	TArray<float> ExpireTime;
+	//next instance to write
+	int32 Head = 0;
+	//visible instances
+	int32 Count = 0;
+};
+
+//shell or clip still simulate physics
+USTRUCT()
+struct FTPSDropMeshBody
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	AStaticMeshActor* Actor = nullptr;
+	UPROPERTY()
+	UStaticMesh* DropMesh = nullptr;
+
+	float StartTime = 0.0f;
+	float LifeTime = 0.0f;
+};
+
+/**
+ * Shell and clip debris manager. Few physics bodies simulate at same time, when body sleep (or budget is full)
+ * it is moved to instanced static mesh of his DropMesh and physics actor is reused for next drop.
+ */
+UCLASS()
+class TPS_API UTPSDropMeshSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	void SpawnDropMesh(UStaticMesh* DropMesh, const FTransform& Transform, FVector Impulse, float LifeTime, float CustomMass);
+
+protected:
+	AStaticMeshActor* GetFreeBody();
+	void SettleBody(int32 BodyIndex);
+	FTPSDropMeshRing& GetRing(UStaticMesh* DropMesh);
+	void AddSettledInstance(FTPSDropMeshRing& Ring, const FTransform& Transform, float ExpireTime);
+	void ExpireInstances(FTPSDropMeshRing& Ring, float Now);
+
+	UPROPERTY()
+	AActor* InstancesHolder = nullptr;
+	UPROPERTY()
+	TMap<UStaticMesh*, FTPSDropMeshRing> Rings;
+	//oldest first
+	UPROPERTY()
+	TArray<FTPSDropMeshBody> SimulatingBodies;
+	UPROPERTY()
+	TArray<AStaticMeshActor*> FreeBodies;
+};
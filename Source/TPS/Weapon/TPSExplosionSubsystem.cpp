@@ -0,0 +1,250 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSExplosionSubsystem.h"
+#include "Engine/World.h"
+#include "WorldCollision.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+#include "ProjectileDefault.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("Explosion Resolve"), STAT_TPS_ExplosionResolve, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosions"), STAT_TPS_Explosions, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion Clusters"), STAT_TPS_ExplosionClusters, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion LOS Traces"), STAT_TPS_ExplosionTraces, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Explosion LOS Traces Shared"), STAT_TPS_ExplosionTracesShared, STATGROUP_TPS);
+
+int32 ExplosionBatch = 1;
+FAutoConsoleVariableRef CVarExplosionBatch(
+	TEXT("TPS.Explosion.Batch"),
+	ExplosionBatch,
+	TEXT("Resolve explosions of frame together, 0 - ApplyRadialDamageWithFalloff for every explosion"),
+	ECVF_Default);
+
+float ExplosionTraceShareDistance = 16.0f;
+FAutoConsoleVariableRef CVarExplosionTraceShareDistance(
+	TEXT("TPS.Explosion.TraceShareDistance"),
+	ExplosionTraceShareDistance,
+	TEXT("Explosions closer than this use same line of sight traces"),
+	ECVF_Default);
+
+//same test as engine ComponentIsDamageableFrom with visibility channel
+static bool TraceDamageableFrom(UWorld* World, UPrimitiveComponent* VictimComp, const FVector& Origin, const FCollisionQueryParams& LineParams, FHitResult& OutHit)
+{
+	const FVector TraceEnd = VictimComp->Bounds.Origin;
+	FVector TraceStart = Origin;
+	if (Origin == TraceEnd)
+	{
+		TraceStart.Z += 0.01f;
+	}
+
+	if (World->LineTraceSingleByChannel(OutHit, TraceStart, TraceEnd, ECC_Visibility, LineParams))
+	{
+		return OutHit.GetComponent() == VictimComp;
+	}
+
+	//nothing blocking, victim is visible
+	const FVector FakeHitLoc = VictimComp->GetComponentLocation();
+	OutHit = FHitResult(VictimComp->GetOwner(), VictimComp, FakeHitLoc, (Origin - FakeHitLoc).GetSafeNormal());
+	return true;
+}
+
+void UTPSExplosionSubsystem::Deinitialize()
+{
+	PendingExplosions.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSExplosionSubsystem::Tick(float DeltaTime)
+{
+	ResolveExplosions();
+}
+
+bool UTPSExplosionSubsystem::IsTickable() const
+{
+	return PendingExplosions.Num() > 0;
+}
+
+ETickableTickType UTPSExplosionSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSExplosionSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSExplosionSubsystem::QueueExplosion(const FTPSPendingExplosion& Explosion)
+{
+	INC_DWORD_STAT(STAT_TPS_Explosions);
+
+	if (!ExplosionBatch)
+	{
+		TArray<AActor*> IgnoredActor;
+		UGameplayStatics::ApplyRadialDamageWithFalloff(GetWorld(),
+			Explosion.BaseDamage,
+			Explosion.MinimumDamage,
+			Explosion.Origin,
+			Explosion.InnerRadius,
+			Explosion.OuterRadius,
+			Explosion.DamageFalloff,
+			Explosion.DamageTypeClass, IgnoredActor, Explosion.DamageCauser, Explosion.InstigatedBy);
+		ReleaseCauser(Explosion);
+		return;
+	}
+
+	PendingExplosions.Add(Explosion);
+}
+
+void UTPSExplosionSubsystem::ReleaseCauser(const FTPSPendingExplosion& Explosion)
+{
+	AProjectileDefault* myProjectile = Explosion.bReleaseCauser ? Cast<AProjectileDefault>(Explosion.DamageCauser) : nullptr;
+	//life time could already release it, or it is already used by next shot
+	if (IsValid(myProjectile) && !myProjectile->bIsInPool && myProjectile->TimerSerial == Explosion.CauserSerial)
+	{
+		myProjectile->ReleaseProjectile();
+	}
+}
+
+void UTPSExplosionSubsystem::ResolveExplosions()
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_ExplosionResolve);
+
+	//damage can queue new explosions (chain), they go to next frame
+	const TArray<FTPSPendingExplosion> Explosions = MoveTemp(PendingExplosions);
+	PendingExplosions.Reset();
+
+	//explosions with overlapping spheres go to one cluster
+	const int32 ExplosionNum = Explosions.Num();
+	TArray<bool> IsClustered;
+	IsClustered.Init(false, ExplosionNum);
+	TArray<int32> Stack;
+	TArray<int32> ClusterExplosions;
+
+	for (int32 i = 0; i < ExplosionNum; i++)
+	{
+		if (IsClustered[i])
+			continue;
+
+		IsClustered[i] = true;
+		Stack.Add(i);
+		ClusterExplosions.Reset();
+		while (Stack.Num() > 0)
+		{
+			const int32 j = Stack.Pop(false);
+			ClusterExplosions.Add(j);
+			for (int32 k = 0; k < ExplosionNum; k++)
+			{
+				if (!IsClustered[k] && FVector::DistSquared(Explosions[j].Origin, Explosions[k].Origin) <= FMath::Square(Explosions[j].OuterRadius + Explosions[k].OuterRadius))
+				{
+					IsClustered[k] = true;
+					Stack.Add(k);
+				}
+			}
+		}
+
+		ResolveCluster(Explosions, ClusterExplosions);
+	}
+
+	for (const FTPSPendingExplosion& Explosion : Explosions)
+	{
+		ReleaseCauser(Explosion);
+	}
+}
+
+void UTPSExplosionSubsystem::ResolveCluster(const TArray<FTPSPendingExplosion>& Explosions, const TArray<int32>& ClusterExplosions)
+{
+	INC_DWORD_STAT(STAT_TPS_ExplosionClusters);
+	UWorld* myWorld = GetWorld();
+
+	FBox ClusterBox(ForceInit);
+	TArray<AActor*> IgnoredActors;
+	for (const int32 ExplosionIndex : ClusterExplosions)
+	{
+		const FTPSPendingExplosion& Explosion = Explosions[ExplosionIndex];
+		ClusterBox += FBox::BuildAABB(Explosion.Origin, FVector(Explosion.OuterRadius));
+		if (Explosion.DamageCauser)
+			IgnoredActors.AddUnique(Explosion.DamageCauser);
+	}
+
+	FCollisionQueryParams SphereParams(SCENE_QUERY_STAT(TPSExplosion), false);
+	SphereParams.AddIgnoredActors(IgnoredActors);
+	TArray<FOverlapResult> Overlaps;
+	myWorld->OverlapMultiByObjectType(Overlaps, ClusterBox.GetCenter(), FQuat::Identity, FCollisionObjectQueryParams(FCollisionObjectQueryParams::InitType::AllDynamicObjects), FCollisionShape::MakeSphere(ClusterBox.GetExtent().Size()), SphereParams);
+	if (Overlaps.Num() == 0)
+		return;
+
+	//close origins share line of sight, trace result of [TraceOrigin * OverlapNum + Overlap]
+	TArray<FVector> TraceOrigins;
+	TArray<int32> ExplosionTraceOrigin;
+	for (const int32 ExplosionIndex : ClusterExplosions)
+	{
+		const FVector& Origin = Explosions[ExplosionIndex].Origin;
+		int32 TraceOrigin = TraceOrigins.IndexOfByPredicate([&Origin](const FVector& Other) { return FVector::DistSquared(Origin, Other) <= FMath::Square(ExplosionTraceShareDistance); });
+		if (TraceOrigin == INDEX_NONE)
+			TraceOrigin = TraceOrigins.Add(Origin);
+		ExplosionTraceOrigin.Add(TraceOrigin);
+	}
+
+	//0 - not traced, 1 - visible, 2 - blocked
+	TArray<uint8> TraceState;
+	TraceState.SetNumZeroed(TraceOrigins.Num() * Overlaps.Num());
+	TArray<FHitResult> TraceHits;
+	TraceHits.SetNum(TraceState.Num());
+
+	FCollisionQueryParams LineParams(SCENE_QUERY_STAT(TPSExplosionLOS), true);
+	LineParams.AddIgnoredActors(IgnoredActors);
+
+	TMap<AActor*, TArray<FHitResult>> VictimHits;
+	for (int32 c = 0; c < ClusterExplosions.Num(); c++)
+	{
+		const FTPSPendingExplosion& Explosion = Explosions[ClusterExplosions[c]];
+		VictimHits.Reset();
+
+		for (int32 o = 0; o < Overlaps.Num(); o++)
+		{
+			UPrimitiveComponent* myComp = Overlaps[o].GetComponent();
+			AActor* myActor = Overlaps[o].GetActor();
+			//previous explosion of cluster could destroy it, god mode and not damageable actors are skipped as by engine radial damage
+			if (!IsValid(myComp) || !IsValid(myActor) || !myActor->CanBeDamaged())
+				continue;
+			//same as sphere overlap of this explosion, bounds only if component has no body to query
+			float myDistanceSq = 0.0f;
+			FVector myClosestPoint;
+			if (!myComp->GetSquaredDistanceToCollision(Explosion.Origin, myDistanceSq, myClosestPoint))
+				myDistanceSq = myComp->Bounds.GetBox().ComputeSquaredDistanceToPoint(Explosion.Origin);
+			if (myDistanceSq > FMath::Square(Explosion.OuterRadius))
+				continue;
+
+			const int32 TraceIndex = ExplosionTraceOrigin[c] * Overlaps.Num() + o;
+			if (TraceState[TraceIndex] == 0)
+			{
+				TraceState[TraceIndex] = TraceDamageableFrom(myWorld, myComp, TraceOrigins[ExplosionTraceOrigin[c]], LineParams, TraceHits[TraceIndex]) ? 1 : 2;
+				INC_DWORD_STAT(STAT_TPS_ExplosionTraces);
+			}
+			else
+			{
+				INC_DWORD_STAT(STAT_TPS_ExplosionTracesShared);
+			}
+
+			if (TraceState[TraceIndex] == 1)
+			{
+				VictimHits.FindOrAdd(myActor).Add(TraceHits[TraceIndex]);
+			}
+		}
+
+		for (TPair<AActor*, TArray<FHitResult>>& Victim : VictimHits)
+		{
+			FRadialDamageEvent DmgEvent;
+			DmgEvent.DamageTypeClass = Explosion.DamageTypeClass ? Explosion.DamageTypeClass : TSubclassOf<UDamageType>(UDamageType::StaticClass());
+			DmgEvent.Origin = Explosion.Origin;
+			DmgEvent.Params = FRadialDamageParams(Explosion.BaseDamage, Explosion.MinimumDamage, Explosion.InnerRadius, Explosion.OuterRadius, Explosion.DamageFalloff);
+			DmgEvent.ComponentHits = MoveTemp(Victim.Value);
+
+			Victim.Key->TakeDamage(Explosion.BaseDamage, DmgEvent, Explosion.InstigatedBy, Explosion.DamageCauser);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSExplosionSubsystem.generated.h"
+
+class AController;
+class UDamageType;
+
+//radial falloff damage waiting for end of frame
+USTRUCT()
+struct FTPSPendingExplosion
+{
+	GENERATED_BODY()
+
+	FVector Origin = FVector::ZeroVector;
+	float BaseDamage = 0.0f;
+	float MinimumDamage = 0.0f;
+	float InnerRadius = 0.0f;
+	float OuterRadius = 0.0f;
+	float DamageFalloff = 1.0f;
+	//causer is pooled projectile, released after its damage is applied so it is still valid causer with its archetype
+	bool bReleaseCauser = false;
+	uint32 CauserSerial = 0;
+
+	UPROPERTY()
+	TSubclassOf<UDamageType> DamageTypeClass;
+	UPROPERTY()
+	AActor* DamageCauser = nullptr;
+	UPROPERTY()
+	AController* InstigatedBy = nullptr;
+};
+
+/**
+ * Server explosions of one frame are resolved together: overlapping explosions are merged in cluster with one
+ * sphere overlap, line of sight from close origins to component is traced once, then falloff damage is applied
+ * per explosion and actor same as UGameplayStatics::ApplyRadialDamageWithFalloff.
+ */
+UCLASS()
+class TPS_API UTPSExplosionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	//damage applied at end of frame, with TPS.Explosion.Batch 0 at once
+	void QueueExplosion(const FTPSPendingExplosion& Explosion);
+
+protected:
+	void ResolveExplosions();
+	void ResolveCluster(const TArray<FTPSPendingExplosion>& Explosions, const TArray<int32>& ClusterExplosions);
+	static void ReleaseCauser(const FTPSPendingExplosion& Explosion);
+
+	UPROPERTY()
+	TArray<FTPSPendingExplosion> PendingExplosions;
+};
@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSPelletBroadphase.h"
+#include "Engine/World.h"
+#include "WorldCollision.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "../TPS.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pellet Rays Dynamic"), STAT_TPS_PelletRaysDynamic, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pellet Rays Static"), STAT_TPS_PelletRaysStatic, STATGROUP_TPS);
+
+void FTPSPelletBroadphase::SetRays(const FVector& Start, const TArray<FVector>& TraceEnds)
+{
+	Origin = Start;
+	RaysNum = TraceEnds.Num();
+
+	const int32 LanesNum = Align(RaysNum, 4);
+	InvDirX.SetNumZeroed(LanesNum);
+	InvDirY.SetNumZeroed(LanesNum);
+	InvDirZ.SetNumZeroed(LanesNum);
+	RayLength.SetNumZeroed(LanesNum);
+
+	//axis parallel ray get big inverse instead of inf, so 0 * inf don't make NaN
+	auto SafeInverse = [](float Value) { return 1.0f / (FMath::Abs(Value) > KINDA_SMALL_NUMBER ? Value : (Value < 0.0f ? -KINDA_SMALL_NUMBER : KINDA_SMALL_NUMBER)); };
+	for (int32 i = 0; i < RaysNum; i++)
+	{
+		FVector Dir;
+		float Length;
+		(TraceEnds[i] - Start).ToDirectionAndLength(Dir, Length);
+		InvDirX[i] = SafeInverse(Dir.X);
+		InvDirY[i] = SafeInverse(Dir.Y);
+		InvDirZ[i] = SafeInverse(Dir.Z);
+		RayLength[i] = Length;
+	}
+}
+
+void FTPSPelletBroadphase::MarkRaysInBox(const FBox& Box, TArray<bool>& InOutRays) const
+{
+	//slab test, box relative to ray origin
+	const VectorRegister MinX = VectorSetFloat1(Box.Min.X - Origin.X);
+	const VectorRegister MinY = VectorSetFloat1(Box.Min.Y - Origin.Y);
+	const VectorRegister MinZ = VectorSetFloat1(Box.Min.Z - Origin.Z);
+	const VectorRegister MaxX = VectorSetFloat1(Box.Max.X - Origin.X);
+	const VectorRegister MaxY = VectorSetFloat1(Box.Max.Y - Origin.Y);
+	const VectorRegister MaxZ = VectorSetFloat1(Box.Max.Z - Origin.Z);
+
+	for (int32 i = 0; i < RaysNum; i += 4)
+	{
+		const VectorRegister InvX = VectorLoad(InvDirX.GetData() + i);
+		const VectorRegister InvY = VectorLoad(InvDirY.GetData() + i);
+		const VectorRegister InvZ = VectorLoad(InvDirZ.GetData() + i);
+
+		const VectorRegister T1X = VectorMultiply(MinX, InvX);
+		const VectorRegister T2X = VectorMultiply(MaxX, InvX);
+		const VectorRegister T1Y = VectorMultiply(MinY, InvY);
+		const VectorRegister T2Y = VectorMultiply(MaxY, InvY);
+		const VectorRegister T1Z = VectorMultiply(MinZ, InvZ);
+		const VectorRegister T2Z = VectorMultiply(MaxZ, InvZ);
+
+		const VectorRegister TNear = VectorMax(VectorMax(VectorMin(T1X, T2X), VectorMin(T1Y, T2Y)), VectorMax(VectorMin(T1Z, T2Z), VectorZero()));
+		const VectorRegister TFar = VectorMin(VectorMin(VectorMax(T1X, T2X), VectorMax(T1Y, T2Y)), VectorMin(VectorMax(T1Z, T2Z), VectorLoad(RayLength.GetData() + i)));
+
+		const int32 Mask = VectorMaskBits(VectorCompareGE(TFar, TNear));
+		for (int32 Lane = 0; Lane < 4 && i + Lane < RaysNum; Lane++)
+		{
+			if (Mask & (1 << Lane))
+				InOutRays[i + Lane] = true;
+		}
+	}
+}
+
+bool FTPSPelletBroadphase::FindDynamicRays(UWorld* World, const FVector& Start, const TArray<FVector>& TraceEnds, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params, TArray<bool>& OutRays)
+{
+	OutRays.Init(false, TraceEnds.Num());
+
+	FBox ShotBox(ForceInit);
+	ShotBox += Start;
+	for (const FVector& TraceEnd : TraceEnds)
+	{
+		ShotBox += TraceEnd;
+	}
+
+	FCollisionQueryParams OverlapParams(Params);
+	OverlapParams.MobilityType = EQueryMobilityType::Dynamic;
+	OverlapParams.bReturnPhysicalMaterial = false;
+	TArray<FOverlapResult> Overlaps;
+	World->OverlapMultiByChannel(Overlaps, ShotBox.GetCenter(), FQuat::Identity, TraceChannel, FCollisionShape::MakeBox(ShotBox.GetExtent()), OverlapParams);
+
+	if (Overlaps.Num() > 0)
+	{
+		FTPSPelletBroadphase Broadphase;
+		Broadphase.SetRays(Start, TraceEnds);
+		for (const FOverlapResult& Overlap : Overlaps)
+		{
+			UPrimitiveComponent* myComp = Overlap.GetComponent();
+			if (myComp)
+			{
+				Broadphase.MarkRaysInBox(myComp->Bounds.GetBox().ExpandBy(1.0f), OutRays);
+			}
+		}
+	}
+
+	int32 DynamicNum = 0;
+	for (const bool bDynamic : OutRays)
+	{
+		DynamicNum += bDynamic ? 1 : 0;
+	}
+	INC_DWORD_STAT_BY(STAT_TPS_PelletRaysDynamic, DynamicNum);
+	INC_DWORD_STAT_BY(STAT_TPS_PelletRaysStatic, OutRays.Num() - DynamicNum);
+
+	return DynamicNum > 0;
+}
+
+#if !UE_BUILD_SHIPPING
+//TPS.Weapon.PelletBenchmark [Pellets] [Iterations] - shot from player view, trace per pellet against prefilter and traces
+static FAutoConsoleCommandWithWorldAndArgs CmdWeaponPelletBenchmark(
+	TEXT("TPS.Weapon.PelletBenchmark"),
+	TEXT("Compare per pellet LineTraceSingle with pellet broadphase for shot from player view, args are pellets and iterations"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* myPC = World ? World->GetFirstPlayerController() : nullptr;
+		if (!myPC)
+		{
+			UE_LOG(LogTPS, Warning, TEXT("TPS.Weapon.PelletBenchmark - no player"));
+			return;
+		}
+
+		const int32 Pellets = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 64) : 8;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1000;
+		const ECollisionChannel Channel = UEngineTypes::ConvertToCollisionChannel(ETraceTypeQuery::TraceTypeQuery4);
+
+		FVector Start;
+		FRotator ViewRotation;
+		myPC->GetPlayerViewPoint(Start, ViewRotation);
+		FRandomStream Stream(Pellets);
+		TArray<FVector> TraceEnds;
+		for (int32 i = 0; i < Pellets; i++)
+		{
+			TraceEnds.Add(Start + Stream.VRandCone(ViewRotation.Vector(), FMath::DegreesToRadians(5.0f)) * 2000.0f);
+		}
+
+		FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(WeaponHitscan), false, myPC->GetPawn());
+		TraceParams.bReturnPhysicalMaterial = true;
+		FCollisionQueryParams StaticTraceParams(TraceParams);
+		StaticTraceParams.MobilityType = EQueryMobilityType::Static;
+
+		TArray<FHitResult> Hits;
+		Hits.SetNum(Pellets);
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 n = 0; n < Iterations; n++)
+		{
+			for (int32 i = 0; i < Pellets; i++)
+			{
+				World->LineTraceSingleByChannel(Hits[i], Start, TraceEnds[i], Channel, TraceParams);
+			}
+		}
+		const double TraceTime = FPlatformTime::Seconds() - StartTime;
+
+		TArray<FHitResult> BroadphaseHits;
+		BroadphaseHits.SetNum(Pellets);
+		TArray<bool> DynamicRays;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 n = 0; n < Iterations; n++)
+		{
+			FTPSPelletBroadphase::FindDynamicRays(World, Start, TraceEnds, Channel, TraceParams, DynamicRays);
+			for (int32 i = 0; i < Pellets; i++)
+			{
+				World->LineTraceSingleByChannel(BroadphaseHits[i], Start, TraceEnds[i], Channel, DynamicRays[i] ? TraceParams : StaticTraceParams);
+			}
+		}
+		const double BroadphaseTime = FPlatformTime::Seconds() - StartTime;
+
+		int32 DynamicNum = 0;
+		int32 Mismatches = 0;
+		for (int32 i = 0; i < Pellets; i++)
+		{
+			DynamicNum += DynamicRays[i] ? 1 : 0;
+			if (Hits[i].GetComponent() != BroadphaseHits[i].GetComponent() || !FMath::IsNearlyEqual(Hits[i].Distance, BroadphaseHits[i].Distance, 0.1f))
+				Mismatches++;
+		}
+
+		UE_LOG(LogTPS, Log, TEXT("TPS.Weapon.PelletBenchmark %d pellets x %d - traces %.3f ms, broadphase %.3f ms, dynamic rays %d, mismatches %d"),
+			Pellets, Iterations, TraceTime * 1000.0, BroadphaseTime * 1000.0, DynamicNum, Mismatches);
+	}));
+#endif
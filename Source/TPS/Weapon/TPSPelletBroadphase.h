@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+struct FCollisionQueryParams;
+
+/**
+ * Prefilter for pellets of one shot. Pellets share origin, so rays are kept as inverse directions padded to 4 and tested
+ * by vector registers against bounds of movable components near shot (pawns, physics props), found by one overlap.
+ * Pellet which miss all of them can't hit anything movable and is traced against static world only.
+ */
+struct TPS_API FTPSPelletBroadphase
+{
+	void SetRays(const FVector& Start, const TArray<FVector>& TraceEnds);
+	//set true for every ray which enter Box before its end
+	void MarkRaysInBox(const FBox& Box, TArray<bool>& InOutRays) const;
+
+	//one overlap of shot bounds on TraceChannel, OutRays is true for rays near movable components. Return false if there are none
+	static bool FindDynamicRays(UWorld* World, const FVector& Start, const TArray<FVector>& TraceEnds, ECollisionChannel TraceChannel, const FCollisionQueryParams& Params, TArray<bool>& OutRays);
+
+protected:
+	FVector Origin = FVector::ZeroVector;
+	int32 RaysNum = 0;
+	TArray<float> InvDirX;
+	TArray<float> InvDirY;
+	TArray<float> InvDirZ;
+	TArray<float> RayLength;
+};
@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSProjectileArchetypeSubsystem.h"
+#include "../TPS.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Archetypes"), STAT_TPS_ProjectileArchetypes, STATGROUP_TPS);
+
+void UTPSProjectileArchetypeSubsystem::Deinitialize()
+{
+	for (TPair<int32, FInfoAssetsRequest>& Request : InfoAssetsRequests)
+	{
+		if (Request.Value.Handle.IsValid())
+			Request.Value.Handle->CancelHandle();
+	}
+	InfoAssetsRequests.Empty();
+	LastInfoArchetype = INDEX_NONE;
+
+	DEC_DWORD_STAT_BY(STAT_TPS_ProjectileArchetypes, Archetypes.Num());
+	Archetypes.Empty();
+	ArchetypeByKey.Empty();
+
+	Super::Deinitialize();
+}
+
+int32 UTPSProjectileArchetypeSubsystem::InternArchetype(FName Key, const FProjectileInfo& ProjectileInfo)
+{
+	if (!Key.IsNone())
+	{
+		const int32* Index = ArchetypeByKey.Find(Key);
+		if (Index)
+			return *Index;
+	}
+
+	const int32 Index = Archetypes.AddDefaulted();
+	FTPSProjectileArchetype& myArchetype = Archetypes[Index];
+	myArchetype.Info = ProjectileInfo;
+
+	for (const TPair<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UMaterialInterface>>& HitDecal : ProjectileInfo.HitDecals)
+	{
+		if (HitDecal.Key < SurfaceType_Max)
+			myArchetype.HitDecals[HitDecal.Key] = HitDecal.Value;
+	}
+	for (const TPair<TEnumAsByte<EPhysicalSurface>, TSoftObjectPtr<UParticleSystem>>& HitFX : ProjectileInfo.HitFXs)
+	{
+		if (HitFX.Key < SurfaceType_Max)
+			myArchetype.HitFXs[HitFX.Key] = HitFX.Value;
+	}
+
+	if (!Key.IsNone())
+		ArchetypeByKey.Add(Key, Index);
+	INC_DWORD_STAT(STAT_TPS_ProjectileArchetypes);
+	return Index;
+}
+
+int32 UTPSProjectileArchetypeSubsystem::InternArchetypeByInfo(const FProjectileInfo& ProjectileInfo)
+{
+	UScriptStruct* myStruct = FProjectileInfo::StaticStruct();
+	if (InfoAssetsRequests.Contains(LastInfoArchetype) && myStruct->CompareScriptStruct(&Archetypes[LastInfoArchetype].Info, &ProjectileInfo, PPF_None))
+		return LastInfoArchetype;
+	for (const TPair<int32, FInfoAssetsRequest>& Request : InfoAssetsRequests)
+	{
+		if (myStruct->CompareScriptStruct(&Archetypes[Request.Key].Info, &ProjectileInfo, PPF_None))
+		{
+			LastInfoArchetype = Request.Key;
+			return Request.Key;
+		}
+	}
+
+	const int32 Index = InternArchetype(NAME_None, ProjectileInfo);
+	FInfoAssetsRequest& Request = InfoAssetsRequests.Add(Index);
+	LastInfoArchetype = Index;
+
+	//archetype resolve soft assets on use, so it can be made before they are loaded
+	TArray<FSoftObjectPath> Assets;
+	ProjectileInfo.GetAssetsToStream(Assets);
+	if (Assets.Num() > 0)
+	{
+		Request.Handle = InfoStreamable.RequestAsyncLoad(Assets, FStreamableDelegate::CreateUObject(this, &UTPSProjectileArchetypeSubsystem::OnInfoAssetsLoaded, Index), FStreamableManager::AsyncLoadHighPriority);
+	}
+	return Index;
+}
+
+bool UTPSProjectileArchetypeSubsystem::IsArchetypeLoaded(int32 Index) const
+{
+	if (!Archetypes.IsValidIndex(Index))
+		return false;
+
+	const FInfoAssetsRequest* Request = InfoAssetsRequests.Find(Index);
+	return !Request || !Request->Handle.IsValid() || Request->Handle->HasLoadCompleted();
+}
+
+void UTPSProjectileArchetypeSubsystem::CallWhenArchetypeLoaded(int32 Index, FStreamableDelegate OnLoaded)
+{
+	FInfoAssetsRequest* Request = InfoAssetsRequests.Find(Index);
+	if (Request && !IsArchetypeLoaded(Index))
+		Request->OnLoaded.Add(OnLoaded);
+	else
+		OnLoaded.ExecuteIfBound();
+}
+
+void UTPSProjectileArchetypeSubsystem::OnInfoAssetsLoaded(int32 Index)
+{
+	FInfoAssetsRequest* Request = InfoAssetsRequests.Find(Index);
+	if (!Request)
+		return;
+
+	TArray<FStreamableDelegate> myOnLoaded = MoveTemp(Request->OnLoaded);
+	for (FStreamableDelegate& OnLoaded : myOnLoaded)
+	{
+		OnLoaded.ExecuteIfBound();
+	}
+}
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "../FuncLibrary/Types.h"
+#include "TPSProjectileArchetypeSubsystem.generated.h"
+
+/**
+ * Table of projectile archetypes of the world. Weapon intern its FProjectileInfo once after assets are loaded,
+ * projectiles and virtual bullets keep only index and read shared archetype on hit. Index is local to machine.
+ */
+UCLASS()
+class TPS_API UTPSProjectileArchetypeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//same Key return index of archetype made first time, NAME_None always make new one
+	int32 InternArchetype(FName Key, const FProjectileInfo& ProjectileInfo);
+	//for info made at runtime without name, same info by value is interned once and its assets are streamed
+	int32 InternArchetypeByInfo(const FProjectileInfo& ProjectileInfo);
+	//archetype of weapon is made after its assets are loaded, archetype of info can wait for them
+	bool IsArchetypeLoaded(int32 Index) const;
+	void CallWhenArchetypeLoaded(int32 Index, FStreamableDelegate OnLoaded);
+	//pointer is valid until next intern
+	const FTPSProjectileArchetype* GetArchetype(int32 Index) const { return Archetypes.IsValidIndex(Index) ? &Archetypes[Index] : nullptr; }
+
+	UFUNCTION(BlueprintCallable, Category = "Projectile")
+	int32 GetArchetypesNum() const { return Archetypes.Num(); }
+
+protected:
+	UPROPERTY()
+	TArray<FTPSProjectileArchetype> Archetypes;
+	TMap<FName, int32> ArchetypeByKey;
+
+	struct FInfoAssetsRequest
+	{
+		TSharedPtr<FStreamableHandle> Handle;
+		TArray<FStreamableDelegate> OnLoaded;
+	};
+	void OnInfoAssetsLoaded(int32 Index);
+	//by archetype index, nobody else request assets of blueprint info so they stay loaded while world exist
+	TMap<int32, FInfoAssetsRequest> InfoAssetsRequests;
+	FStreamableManager InfoStreamable;
+	//blueprint spawn same info again and again
+	int32 LastInfoArchetype = INDEX_NONE;
+};
@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSProjectilePoolSubsystem.h"
+#include "ProjectileDefault.h"
+#include "Engine/World.h"
+#include "../TPS.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Pool Hits"), STAT_TPS_ProjectilePoolHits, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Pool Misses"), STAT_TPS_ProjectilePoolMisses, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectiles In Pool"), STAT_TPS_ProjectilesInPool, STATGROUP_TPS);
+
+int32 ProjectilePoolEnable = 1;
+FAutoConsoleVariableRef CVarProjectilePoolEnable(
+	TEXT("TPS.ProjectilePool.Enable"),
+	ProjectilePoolEnable,
+	TEXT("Reuse projectile actors instead of spawn and destroy"),
+	ECVF_Default);
+
+int32 ProjectilePoolWarmUp = 16;
+FAutoConsoleVariableRef CVarProjectilePoolWarmUp(
+	TEXT("TPS.ProjectilePool.WarmUp"),
+	ProjectilePoolWarmUp,
+	TEXT("Projectiles spawned to pool for each projectile of shot when weapon init"),
+	ECVF_Default);
+
+int32 ProjectilePoolMaxFree = 128;
+FAutoConsoleVariableRef CVarProjectilePoolMaxFree(
+	TEXT("TPS.ProjectilePool.MaxFree"),
+	ProjectilePoolMaxFree,
+	TEXT("Max free projectiles kept in pool for one projectile class, other destroyed"),
+	ECVF_Default);
+
+void UTPSProjectilePoolSubsystem::Deinitialize()
+{
+	UE_LOG(LogTPS, Log, TEXT("UTPSProjectilePoolSubsystem - hits = %d, misses = %d, releases = %d"), PoolHits, PoolMisses, PoolReleases);
+
+	for (TPair<UClass*, FTPSProjectilePool>& Pool : Pools)
+	{
+		DEC_DWORD_STAT_BY(STAT_TPS_ProjectilesInPool, Pool.Value.FreeProjectiles.Num());
+	}
+	for (TPair<UClass*, FTPSProjectilePool>& Pool : CosmeticPools)
+	{
+		DEC_DWORD_STAT_BY(STAT_TPS_ProjectilesInPool, Pool.Value.FreeProjectiles.Num());
+	}
+	Pools.Empty();
+	CosmeticPools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSProjectilePoolSubsystem::WarmUp(TSubclassOf<AProjectileDefault> ProjectileClass, int32 ProjectilesByShot, bool bReplicated)
+{
+	if (!ProjectileClass || !CanUsePool())
+		return;
+
+	const int32 Count = FMath::Min(FMath::Max(ProjectilesByShot, 1) * ProjectilePoolWarmUp, ProjectilePoolMaxFree);
+
+	FTPSProjectilePool& Pool = Pools.FindOrAdd(ProjectileClass);
+	while (Pool.SpawnedCount < Count)
+	{
+		AProjectileDefault* NewProjectile = SpawnPooledProjectile(ProjectileClass, FTransform::Identity, nullptr, nullptr, bReplicated, false);
+		if (!NewProjectile)
+			break;
+
+		NewProjectile->EnterPool();
+		Pool.FreeProjectiles.Add(NewProjectile);
+		INC_DWORD_STAT(STAT_TPS_ProjectilesInPool);
+	}
+}
+
+AProjectileDefault* UTPSProjectilePoolSubsystem::AcquireProjectile(TSubclassOf<AProjectileDefault> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, bool bReplicated)
+{
+	if (!ProjectileClass)
+		return nullptr;
+
+	AProjectileDefault* myProjectile = AcquireFromPool(false, ProjectileClass, Location, Rotation, NewOwner, NewInstigator);
+	if (!myProjectile)
+		return SpawnPooledProjectile(ProjectileClass, FTransform(Rotation, Location), NewOwner, NewInstigator, bReplicated, false);
+
+	//pooled projectile can be from time when TPS.Projectile.LocalCosmetic was different
+	if (myProjectile->GetIsReplicated() != bReplicated)
+		myProjectile->SetReplicates(bReplicated);
+	return myProjectile;
+}
+
+AProjectileDefault* UTPSProjectilePoolSubsystem::AcquireCosmeticProjectile(TSubclassOf<AProjectileDefault> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator)
+{
+	if (!ProjectileClass)
+		return nullptr;
+
+	AProjectileDefault* myProjectile = AcquireFromPool(true, ProjectileClass, Location, Rotation, NewOwner, NewInstigator);
+	if (!myProjectile)
+		myProjectile = SpawnPooledProjectile(ProjectileClass, FTransform(Rotation, Location), NewOwner, NewInstigator, false, true);
+	return myProjectile;
+}
+
+AProjectileDefault* UTPSProjectilePoolSubsystem::AcquireFromPool(bool bCosmetic, UClass* ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator)
+{
+	if (CanUsePool(bCosmetic))
+	{
+		FTPSProjectilePool& Pool = (bCosmetic ? CosmeticPools : Pools).FindOrAdd(ProjectileClass);
+		while (Pool.FreeProjectiles.Num() > 0)
+		{
+			AProjectileDefault* myProjectile = Pool.FreeProjectiles.Pop(false);
+			DEC_DWORD_STAT(STAT_TPS_ProjectilesInPool);
+			//can be destroyed by level streaming
+			if (IsValid(myProjectile))
+			{
+				myProjectile->SetOwner(NewOwner);
+				myProjectile->SetInstigator(NewInstigator);
+				myProjectile->SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::ResetPhysics);
+
+				PoolHits++;
+				INC_DWORD_STAT(STAT_TPS_ProjectilePoolHits);
+				return myProjectile;
+			}
+			Pool.SpawnedCount--;
+		}
+		PoolMisses++;
+		INC_DWORD_STAT(STAT_TPS_ProjectilePoolMisses);
+	}
+
+	return nullptr;
+}
+
+bool UTPSProjectilePoolSubsystem::ReleaseProjectile(AProjectileDefault* Projectile)
+{
+	if (!IsValid(Projectile) || !Projectile->HasAuthority() || !CanUsePool(Projectile->bCosmetic))
+		return false;
+
+	if (Projectile->bIsInPool)
+		return true;
+
+	FTPSProjectilePool* Pool = (Projectile->bCosmetic ? CosmeticPools : Pools).Find(Projectile->GetClass());
+	if (!Pool || Pool->FreeProjectiles.Num() >= ProjectilePoolMaxFree)
+	{
+		if (Pool)
+			Pool->SpawnedCount--;
+		return false;
+	}
+
+	Projectile->DeactivateProjectile_Multicast();
+	Pool->FreeProjectiles.Add(Projectile);
+	PoolReleases++;
+	INC_DWORD_STAT(STAT_TPS_ProjectilesInPool);
+
+	return true;
+}
+
+int32 UTPSProjectilePoolSubsystem::GetFreeProjectilesNum() const
+{
+	int32 Result = 0;
+	for (const TPair<UClass*, FTPSProjectilePool>& Pool : Pools)
+	{
+		Result += Pool.Value.FreeProjectiles.Num();
+	}
+	for (const TPair<UClass*, FTPSProjectilePool>& Pool : CosmeticPools)
+	{
+		Result += Pool.Value.FreeProjectiles.Num();
+	}
+	return Result;
+}
+
+bool UTPSProjectilePoolSubsystem::CanUsePool(bool bCosmetic) const
+{
+	UWorld* myWorld = GetWorld();
+	return ProjectilePoolEnable && myWorld && myWorld->IsGameWorld() && (bCosmetic || myWorld->GetNetMode() != NM_Client);
+}
+
+AProjectileDefault* UTPSProjectilePoolSubsystem::SpawnPooledProjectile(UClass* ProjectileClass, const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bReplicated, bool bCosmetic)
+{
+	UWorld* myWorld = GetWorld();
+	if (!myWorld)
+		return nullptr;
+
+	AProjectileDefault* NewProjectile = myWorld->SpawnActorDeferred<AProjectileDefault>(ProjectileClass, SpawnTransform, NewOwner, NewInstigator, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (NewProjectile)
+	{
+		NewProjectile->bCosmetic = bCosmetic;
+		NewProjectile->SetReplicates(bReplicated && !bCosmetic);
+		NewProjectile->FinishSpawning(SpawnTransform);
+		if (CanUsePool(bCosmetic))
+		{
+			(bCosmetic ? CosmeticPools : Pools).FindOrAdd(ProjectileClass).SpawnedCount++;
+		}
+	}
+	return NewProjectile;
+}
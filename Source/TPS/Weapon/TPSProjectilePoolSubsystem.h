@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSProjectilePoolSubsystem.generated.h"
+
+class AProjectileDefault;
+
+USTRUCT()
+struct FTPSProjectilePool
+{
+	GENERATED_BODY()
+
+	//projectiles waiting in pool (hidden, no collision, no movement)
+	UPROPERTY()
+	TArray<AProjectileDefault*> FreeProjectiles;
+	//all projectiles ever created by pool for this class
+	int32 SpawnedCount = 0;
+};
+
+/**
+ * Keeps spawned projectiles alive and hands them out again instead of SpawnActor/Destroy on every shot.
+ * Works on server, clients get activate/deactivate by projectile multicast. Local cosmetic projectiles (not replicated,
+ * spawned by client from weapon shot event) are kept in separate pools on client.
+ */
+UCLASS()
+class TPS_API UTPSProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//spawn projectiles to pool until pool have enough projectiles of this class for weapon
+	void WarmUp(TSubclassOf<AProjectileDefault> ProjectileClass, int32 ProjectilesByShot, bool bReplicated = true);
+	//get free projectile from pool or spawn new, projectile still need InitProjectileArchetype and activate
+	//not replicated projectile is seen by clients only as cosmetic copy
+	AProjectileDefault* AcquireProjectile(TSubclassOf<AProjectileDefault> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator, bool bReplicated = true);
+	//client local projectile without damage
+	AProjectileDefault* AcquireCosmeticProjectile(TSubclassOf<AProjectileDefault> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator);
+	//return false if projectile can't be pooled, caller must destroy it
+	bool ReleaseProjectile(AProjectileDefault* Projectile);
+
+	UFUNCTION(BlueprintCallable, Category = "ProjectilePool")
+	int32 GetPoolHits() const { return PoolHits; }
+	UFUNCTION(BlueprintCallable, Category = "ProjectilePool")
+	int32 GetPoolMisses() const { return PoolMisses; }
+	UFUNCTION(BlueprintCallable, Category = "ProjectilePool")
+	int32 GetFreeProjectilesNum() const;
+
+protected:
+	bool CanUsePool(bool bCosmetic = false) const;
+	AProjectileDefault* AcquireFromPool(bool bCosmetic, UClass* ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* NewOwner, APawn* NewInstigator);
+	AProjectileDefault* SpawnPooledProjectile(UClass* ProjectileClass, const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bReplicated, bool bCosmetic);
+
+	UPROPERTY()
+	TMap<UClass*, FTPSProjectilePool> Pools;
+	UPROPERTY()
+	TMap<UClass*, FTPSProjectilePool> CosmeticPools;
+
+	int32 PoolHits = 0;
+	int32 PoolMisses = 0;
+	int32 PoolReleases = 0;
+};
@@ -0,0 +1,277 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSProjectileRenderSubsystem.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "EngineUtils.h"
+#include "RenderCore.h"
+#include "ProjectileDefault.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("ProjectileRender Tick"), STAT_TPS_ProjectileRenderTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Render Batches"), STAT_TPS_ProjectileRenderBatches, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Render Instances"), STAT_TPS_ProjectileRenderInstances, STATGROUP_TPS);
+
+int32 ProjectileInstancedRender = 1;
+FAutoConsoleVariableRef CVarProjectileInstancedRender(
+	TEXT("TPS.Projectile.InstancedRender"),
+	ProjectileInstancedRender,
+	TEXT("Draw projectile meshes and tracers as instances of one mesh component per mesh, 0 - component per projectile. Used by next shots"),
+	ECVF_Default);
+
+void UTPSProjectileRenderSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_ProjectileRenderBatches, Batches.Num());
+	DEC_DWORD_STAT_BY(STAT_TPS_ProjectileRenderInstances, InstancesNum);
+	InstancesNum = 0;
+	Batches.Empty();
+	MeshBatches.Empty();
+	TracerBatches.Empty();
+	InstancesHolder = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UTPSProjectileRenderSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_ProjectileRenderTick);
+
+	for (FTPSProjectileRenderBatch& Batch : Batches)
+	{
+		UpdateBatch(Batch);
+	}
+}
+
+bool UTPSProjectileRenderSubsystem::IsTickable() const
+{
+	//batch stay after last projectile, its instances are hidden on next tick and then it sleep
+	for (const FTPSProjectileRenderBatch& Batch : Batches)
+	{
+		if (Batch.bDirty)
+			return true;
+	}
+	return false;
+}
+
+ETickableTickType UTPSProjectileRenderSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSProjectileRenderSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSProjectileRenderSubsystem, STATGROUP_Tickables);
+}
+
+bool UTPSProjectileRenderSubsystem::CanRender() const
+{
+	return ProjectileInstancedRender != 0 && GetWorld() && GetWorld()->GetNetMode() != NM_DedicatedServer;
+}
+
+void UTPSProjectileRenderSubsystem::AddMesh(AProjectileDefault* Projectile, UStaticMesh* Mesh, const FTransform& Offset, FTPSProjectileRenderHandle& OutHandle)
+{
+	Remove(OutHandle);
+	if (!Projectile || !Mesh)
+		return;
+
+	OutHandle.Batch = GetBatch(Mesh, false);
+	OutHandle.Slot = AddToBatch(OutHandle.Batch, Projectile, Offset, 0.0f);
+}
+
+void UTPSProjectileRenderSubsystem::AddTracer(AProjectileDefault* Projectile, UStaticMesh* TracerMesh, float TracerLength, FTPSProjectileRenderHandle& OutHandle)
+{
+	Remove(OutHandle);
+	if (!Projectile || !TracerMesh || TracerLength <= 0.0f)
+		return;
+
+	OutHandle.Batch = GetBatch(TracerMesh, true);
+	OutHandle.Slot = AddToBatch(OutHandle.Batch, Projectile, FTransform::Identity, TracerLength);
+}
+
+void UTPSProjectileRenderSubsystem::Remove(FTPSProjectileRenderHandle& Handle)
+{
+	if (!Handle.IsValid() || !Batches.IsValidIndex(Handle.Batch) || !Batches[Handle.Batch].Projectiles.IsValidIndex(Handle.Slot))
+	{
+		Handle = FTPSProjectileRenderHandle();
+		return;
+	}
+
+	//swap with last slot, moved projectile get new slot
+	FTPSProjectileRenderBatch& Batch = Batches[Handle.Batch];
+	const int32 LastSlot = Batch.Projectiles.Num() - 1;
+	if (Handle.Slot != LastSlot)
+	{
+		AProjectileDefault* myMoved = Batch.Projectiles[LastSlot].Get();
+		if (myMoved)
+		{
+			GetProjectileHandle(myMoved, Batch.bTracer).Slot = Handle.Slot;
+		}
+	}
+	Batch.Projectiles.RemoveAtSwap(Handle.Slot, 1, false);
+	Batch.Offsets.RemoveAtSwap(Handle.Slot, 1, false);
+	Batch.TracerLengths.RemoveAtSwap(Handle.Slot, 1, false);
+	Batch.bDirty = true;
+
+	InstancesNum--;
+	DEC_DWORD_STAT(STAT_TPS_ProjectileRenderInstances);
+	Handle = FTPSProjectileRenderHandle();
+}
+
+void UTPSProjectileRenderSubsystem::GetDrawCalls(int32& OutInstanced, int32& OutPerProjectile) const
+{
+	OutInstanced = 0;
+	OutPerProjectile = 0;
+	for (const FTPSProjectileRenderBatch& Batch : Batches)
+	{
+		if (Batch.Projectiles.Num() > 0 && Batch.Mesh)
+		{
+			const int32 Sections = Batch.Mesh->GetNumSections(0);
+			OutInstanced += Sections;
+			OutPerProjectile += Sections * Batch.Projectiles.Num();
+		}
+	}
+}
+
+int32 UTPSProjectileRenderSubsystem::GetBatch(UStaticMesh* Mesh, bool bTracer)
+{
+	TMap<UStaticMesh*, int32>& myBatches = bTracer ? TracerBatches : MeshBatches;
+	if (const int32* Found = myBatches.Find(Mesh))
+		return *Found;
+
+	if (!InstancesHolder)
+	{
+		FActorSpawnParameters Param;
+		Param.ObjectFlags |= RF_Transient;
+		InstancesHolder = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, Param);
+
+		USceneComponent* myRoot = NewObject<USceneComponent>(InstancesHolder, TEXT("Root"));
+		InstancesHolder->SetRootComponent(myRoot);
+		myRoot->RegisterComponent();
+	}
+
+	const int32 Index = Batches.AddDefaulted();
+	FTPSProjectileRenderBatch& Batch = Batches[Index];
+	Batch.Mesh = Mesh;
+	Batch.bTracer = bTracer;
+	//tracer front end is put on projectile, mesh length is along X
+	const FBoxSphereBounds myBounds = Mesh->GetBounds();
+	Batch.MeshLength = FMath::Max(myBounds.BoxExtent.X * 2.0f, 1.0f);
+	Batch.MeshFrontX = myBounds.Origin.X + myBounds.BoxExtent.X;
+
+	Batch.Instances = NewObject<UInstancedStaticMeshComponent>(InstancesHolder);
+	Batch.Instances->SetMobility(EComponentMobility::Movable);
+	Batch.Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Batch.Instances->SetGenerateOverlapEvents(false);
+	Batch.Instances->SetCanEverAffectNavigation(false);
+	Batch.Instances->SetCastShadow(!bTracer);
+	Batch.Instances->SetStaticMesh(Mesh);
+	Batch.Instances->SetupAttachment(InstancesHolder->GetRootComponent());
+	Batch.Instances->RegisterComponent();
+
+	myBatches.Add(Mesh, Index);
+	INC_DWORD_STAT(STAT_TPS_ProjectileRenderBatches);
+	return Index;
+}
+
+int32 UTPSProjectileRenderSubsystem::AddToBatch(int32 BatchIndex, AProjectileDefault* Projectile, const FTransform& Offset, float TracerLength)
+{
+	FTPSProjectileRenderBatch& Batch = Batches[BatchIndex];
+	Batch.Offsets.Add(Offset);
+	Batch.TracerLengths.Add(TracerLength);
+	Batch.bDirty = true;
+	InstancesNum++;
+	INC_DWORD_STAT(STAT_TPS_ProjectileRenderInstances);
+	return Batch.Projectiles.Add(Projectile);
+}
+
+void UTPSProjectileRenderSubsystem::UpdateBatch(FTPSProjectileRenderBatch& Batch)
+{
+	if (!Batch.bDirty)
+		return;
+
+	const int32 Num = Batch.Projectiles.Num();
+	const int32 InstanceCount = Batch.Instances ? Batch.Instances->GetInstanceCount() : 0;
+	//without projectiles one update hide freed instances, next add or remove wake batch
+	Batch.bDirty = Num > 0;
+	if (!Batch.Instances || (Num == 0 && InstanceCount == 0))
+		return;
+
+	Batch.Transforms.Reset(FMath::Max(Num, InstanceCount));
+	for (int32 i = 0; i < Num; i++)
+	{
+		const AProjectileDefault* myProjectile = Batch.Projectiles[i].Get();
+		if (!myProjectile)
+		{
+			Batch.Transforms.Add(FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector));
+			continue;
+		}
+
+		const FTransform& myActorTransform = myProjectile->GetActorTransform();
+		if (!Batch.bTracer)
+		{
+			Batch.Transforms.Add(Batch.Offsets[i] * myActorTransform);
+			continue;
+		}
+
+		FVector myDirection = myProjectile->BulletProjectileMovement->Velocity.GetSafeNormal();
+		if (myDirection.IsZero())
+			myDirection = myActorTransform.GetUnitAxis(EAxis::X);
+		const float myScale = Batch.TracerLengths[i] / Batch.MeshLength;
+		Batch.Transforms.Add(FTransform(myDirection.ToOrientationQuat(), myActorTransform.GetLocation() - myDirection * Batch.MeshFrontX * myScale, FVector(myScale, 1.0f, 1.0f)));
+	}
+
+	//few instances after burst, drop them instead of drawing hidden ones
+	if (InstanceCount > Num * 2 + 16)
+	{
+		Batch.Instances->ClearInstances();
+		Batch.Instances->AddInstances(Batch.Transforms, false);
+		return;
+	}
+
+	//free instances stay with zero scale for next shots
+	while (Batch.Transforms.Num() < InstanceCount)
+	{
+		Batch.Transforms.Add(FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector));
+	}
+	if (Num > InstanceCount)
+	{
+		TArray<FTransform> NewTransforms(Batch.Transforms.GetData() + InstanceCount, Num - InstanceCount);
+		Batch.Instances->AddInstances(NewTransforms, false);
+		if (InstanceCount == 0)
+			return;
+		Batch.Transforms.SetNum(InstanceCount, false);
+	}
+	Batch.Instances->BatchUpdateInstancesTransforms(0, Batch.Transforms, false, true, true);
+}
+
+FTPSProjectileRenderHandle& UTPSProjectileRenderSubsystem::GetProjectileHandle(AProjectileDefault* Projectile, bool bTracer) const
+{
+	return bTracer ? Projectile->RenderTracer : Projectile->RenderMesh;
+}
+
+#if !UE_BUILD_SHIPPING
+static FAutoConsoleCommandWithWorld CmdProjectileRenderReport(
+	TEXT("TPS.ProjectileRender.Report"),
+	TEXT("Log projectile render batches, instances, draw calls, trail particles which are not batched and render thread time of last frame. Run with TPS.Projectile.InstancedRender 1 and 0 to compare"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		UTPSProjectileRenderSubsystem* myRender = World ? World->GetSubsystem<UTPSProjectileRenderSubsystem>() : nullptr;
+		if (!myRender)
+			return;
+
+		int32 Instanced = 0;
+		int32 PerProjectile = 0;
+		myRender->GetDrawCalls(Instanced, PerProjectile);
+		//weapon without TracerMesh keep particle trail per projectile
+		int32 Trails = 0;
+		for (TActorIterator<AProjectileDefault> It(World); It; ++It)
+		{
+			if (!It->bIsInPool && It->BulletFX && It->BulletFX->IsActive())
+				Trails++;
+		}
+		UE_LOG(LogTPS, Log, TEXT("TPS.ProjectileRender.Report enabled %d, batches %d, instances %d, draw calls %d instead of %d, trail particles %d, render thread %.2f ms"),
+			myRender->CanRender() ? 1 : 0, myRender->GetBatchesNum(), myRender->GetInstancesNum(), Instanced, PerProjectile, Trails, FPlatformTime::ToMilliseconds(GRenderThreadTime));
+	}));
+#endif
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSProjectileRenderSubsystem.generated.h"
+
+class AProjectileDefault;
+class UInstancedStaticMeshComponent;
+
+//place of projectile in render batch, kept by projectile
+struct FTPSProjectileRenderHandle
+{
+	int32 Batch = INDEX_NONE;
+	int32 Slot = INDEX_NONE;
+
+	bool IsValid() const { return Batch != INDEX_NONE; }
+};
+
+//in-flight projectiles of one mesh, slot i is instance i
+USTRUCT()
+struct FTPSProjectileRenderBatch
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UInstancedStaticMeshComponent* Instances = nullptr;
+	UPROPERTY()
+	UStaticMesh* Mesh = nullptr;
+
+	TArray<TWeakObjectPtr<AProjectileDefault>> Projectiles;
+	//mesh relative to projectile, not used by tracer
+	TArray<FTransform> Offsets;
+	TArray<float> TracerLengths;
+	//tracer mesh is stretched along velocity behind projectile
+	bool bTracer = false;
+	float MeshLength = 100.0f;
+	float MeshFrontX = 50.0f;
+	TArray<FTransform> Transforms;
+	//has projectiles or freed instances are not hidden yet, batch is not updated else
+	bool bDirty = false;
+};
+
+/**
+ * Client renderer of projectile meshes and tracers. Instead of mesh component of every projectile,
+ * all projectiles of same mesh are instances of one instanced static mesh, moved to projectile transforms every frame.
+ * Tracer is a mesh stretched along velocity, batched same way. One batch is one draw call per mesh section.
+ * Only weapon with TracerMesh set replace its trail particle by tracer, others still spawn particle per projectile.
+ */
+UCLASS()
+class TPS_API UTPSProjectileRenderSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	//TPS.Projectile.InstancedRender is on and somebody can see projectiles
+	bool CanRender() const;
+	void AddMesh(AProjectileDefault* Projectile, UStaticMesh* Mesh, const FTransform& Offset, FTPSProjectileRenderHandle& OutHandle);
+	void AddTracer(AProjectileDefault* Projectile, UStaticMesh* TracerMesh, float TracerLength, FTPSProjectileRenderHandle& OutHandle);
+	void Remove(FTPSProjectileRenderHandle& Handle);
+
+	int32 GetBatchesNum() const { return Batches.Num(); }
+	int32 GetInstancesNum() const { return InstancesNum; }
+	//draw calls of batches and draw calls same projectiles would have with own components
+	void GetDrawCalls(int32& OutInstanced, int32& OutPerProjectile) const;
+
+protected:
+	int32 GetBatch(UStaticMesh* Mesh, bool bTracer);
+	int32 AddToBatch(int32 BatchIndex, AProjectileDefault* Projectile, const FTransform& Offset, float TracerLength);
+	void UpdateBatch(FTPSProjectileRenderBatch& Batch);
+	FTPSProjectileRenderHandle& GetProjectileHandle(AProjectileDefault* Projectile, bool bTracer) const;
+
+	UPROPERTY()
+	AActor* InstancesHolder = nullptr;
+	UPROPERTY()
+	TArray<FTPSProjectileRenderBatch> Batches;
+	TMap<UStaticMesh*, int32> MeshBatches;
+	TMap<UStaticMesh*, int32> TracerBatches;
+	int32 InstancesNum = 0;
+};
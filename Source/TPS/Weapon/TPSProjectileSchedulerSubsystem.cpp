@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSProjectileSchedulerSubsystem.h"
+#include "Engine/World.h"
+#include "ProjectileDefault.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("ProjectileScheduler Tick"), STAT_TPS_ProjectileSchedulerTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectile Timers"), STAT_TPS_ProjectileTimers, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Timers Fired"), STAT_TPS_ProjectileTimersFired, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Timers Stale"), STAT_TPS_ProjectileTimersStale, STATGROUP_TPS);
+
+float ProjectileTimerResolution = 1.0f / 60.0f;
+FAutoConsoleVariableRef CVarProjectileTimerResolution(
+	TEXT("TPS.ProjectileTimer.Resolution"),
+	ProjectileTimerResolution,
+	TEXT("Seconds per slot of projectile timing wheel, used when world start"),
+	ECVF_Default);
+
+int32 ProjectileTimerSlots = 256;
+FAutoConsoleVariableRef CVarProjectileTimerSlots(
+	TEXT("TPS.ProjectileTimer.Slots"),
+	ProjectileTimerSlots,
+	TEXT("Slots of projectile timing wheel, used when world start"),
+	ECVF_Default);
+
+void UTPSProjectileSchedulerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	SlotTime = FMath::Max(ProjectileTimerResolution, 0.001f);
+	Slots.SetNum(FMath::Max(ProjectileTimerSlots, 2));
+}
+
+void UTPSProjectileSchedulerSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_ProjectileTimers, TimersNum);
+	TimersNum = 0;
+	Slots.Empty();
+	ProcessingTimers.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSProjectileSchedulerSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_ProjectileSchedulerTick);
+
+	Accumulator += DeltaTime;
+	while (Accumulator >= SlotTime && TimersNum > 0)
+	{
+		Accumulator -= SlotTime;
+		CurrentSlot = (CurrentSlot + 1) % Slots.Num();
+		ProcessSlot(CurrentSlot);
+	}
+
+	//wheel stop with last timer, next schedule count from now
+	if (TimersNum == 0)
+		Accumulator = 0.0f;
+}
+
+bool UTPSProjectileSchedulerSubsystem::IsTickable() const
+{
+	return TimersNum > 0;
+}
+
+ETickableTickType UTPSProjectileSchedulerSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSProjectileSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSProjectileSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSProjectileSchedulerSubsystem::ScheduleTimer(AProjectileDefault* Projectile, ETPSProjectileTimer Type, float Delay)
+{
+	if (!Projectile || Slots.Num() == 0)
+		return;
+
+	//time already passed in current slot count to delay, so at least one slot
+	const int32 SlotsToWait = FMath::Max(FMath::CeilToInt((Delay + Accumulator) / SlotTime), 1);
+
+	FTPSProjectileTimer Timer;
+	Timer.Projectile = Projectile;
+	Timer.Serial = Projectile->TimerSerial;
+	Timer.Type = Type;
+	Timer.Rounds = (SlotsToWait - 1) / Slots.Num();
+	Slots[(CurrentSlot + SlotsToWait) % Slots.Num()].Add(Timer);
+
+	TimersNum++;
+	INC_DWORD_STAT(STAT_TPS_ProjectileTimers);
+}
+
+void UTPSProjectileSchedulerSubsystem::ProcessSlot(int32 Slot)
+{
+	//timer callback can schedule new timers to any slot, so slot is moved out first
+	Swap(ProcessingTimers, Slots[Slot]);
+
+	for (FTPSProjectileTimer& Timer : ProcessingTimers)
+	{
+		AProjectileDefault* myProjectile = Timer.Projectile.Get();
+		if (!myProjectile || myProjectile->TimerSerial != Timer.Serial)
+		{
+			TimersNum--;
+			DEC_DWORD_STAT(STAT_TPS_ProjectileTimers);
+			INC_DWORD_STAT(STAT_TPS_ProjectileTimersStale);
+			continue;
+		}
+
+		if (Timer.Rounds > 0)
+		{
+			Timer.Rounds--;
+			Slots[Slot].Add(Timer);
+			continue;
+		}
+
+		TimersNum--;
+		DEC_DWORD_STAT(STAT_TPS_ProjectileTimers);
+		INC_DWORD_STAT(STAT_TPS_ProjectileTimersFired);
+		myProjectile->OnProjectileTimer(Timer.Type);
+	}
+	ProcessingTimers.Reset();
+}
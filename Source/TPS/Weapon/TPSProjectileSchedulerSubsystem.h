@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSProjectileSchedulerSubsystem.generated.h"
+
+class AProjectileDefault;
+
+enum class ETPSProjectileTimer : uint8
+{
+	LifeTime,
+	Fuse,
+};
+
+//timer in wheel slot, fire when Rounds is 0 on slot visit
+struct FTPSProjectileTimer
+{
+	TWeakObjectPtr<AProjectileDefault> Projectile;
+	//projectile TimerSerial at schedule, timer is stale if projectile was released or reused after
+	uint32 Serial = 0;
+	uint32 Rounds = 0;
+	ETPSProjectileTimer Type = ETPSProjectileTimer::LifeTime;
+};
+
+/**
+ * Server timing wheel for projectile life time and grenade fuse. Timer go to slot by expire time (TPS.ProjectileTimer.Resolution
+ * per slot), longer than one wheel turn wait for Rounds turns. Schedule and cancel are O(1), cancel is done by projectile
+ * serial, so projectiles don't tick and don't use actor life span timers.
+ */
+UCLASS()
+class TPS_API UTPSProjectileSchedulerSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	//call projectile OnProjectileTimer after Delay, until its TimerSerial is changed
+	void ScheduleTimer(AProjectileDefault* Projectile, ETPSProjectileTimer Type, float Delay);
+
+	UFUNCTION(BlueprintCallable, Category = "ProjectileScheduler")
+	int32 GetScheduledTimersNum() const { return TimersNum; }
+
+protected:
+	void ProcessSlot(int32 Slot);
+
+	TArray<TArray<FTPSProjectileTimer>> Slots;
+	TArray<FTPSProjectileTimer> ProcessingTimers;
+	int32 CurrentSlot = 0;
+	int32 TimersNum = 0;
+	float SlotTime = 0.02f;
+	float Accumulator = 0.0f;
+};
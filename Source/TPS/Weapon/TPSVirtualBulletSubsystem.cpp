@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSVirtualBulletSubsystem.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Perception/AISense_Damage.h"
+#include "WeaponDefault.h"
+#include "TPSProjectileArchetypeSubsystem.h"
+#include "../Character/TPSHitProxyComponent.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("VirtualBullet Tick"), STAT_TPS_VirtualBulletTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Virtual Bullets"), STAT_TPS_VirtualBullets, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Virtual Bullet Sweeps"), STAT_TPS_VirtualBulletSweeps, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Virtual Bullet Hits"), STAT_TPS_VirtualBulletHits, STATGROUP_TPS);
+
+float VirtualBulletRadius = 2.0f;
+FAutoConsoleVariableRef CVarVirtualBulletRadius(
+	TEXT("TPS.VirtualBullet.Radius"),
+	VirtualBulletRadius,
+	TEXT("Sphere radius of virtual bullet sweep, 0 - line trace"),
+	ECVF_Default);
+
+float VirtualBulletMaxLifeTime = 10.0f;
+FAutoConsoleVariableRef CVarVirtualBulletMaxLifeTime(
+	TEXT("TPS.VirtualBullet.MaxLifeTime"),
+	VirtualBulletMaxLifeTime,
+	TEXT("Life time of virtual bullet with ProjectileLifeTime 0 (unbounded for actor projectile)"),
+	ECVF_Default);
+
+void UTPSVirtualBulletSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_VirtualBullets, BulletsNum);
+	BulletsNum = 0;
+	Bullets.Empty();
+	Settings.Empty();
+	PendingImpacts.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSVirtualBulletSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_VirtualBulletTick);
+
+	Integrate(DeltaTime);
+	SweepBullets();
+
+	for (TPair<TWeakObjectPtr<AWeaponDefault>, TArray<FTPSShotImpact>>& Impacts : PendingImpacts)
+	{
+		AWeaponDefault* myWeapon = Impacts.Key.Get();
+		if (myWeapon)
+		{
+			myWeapon->ShotImpacts_Multicast(Impacts.Value);
+		}
+	}
+	PendingImpacts.Reset();
+}
+
+bool UTPSVirtualBulletSubsystem::IsTickable() const
+{
+	return BulletsNum > 0;
+}
+
+ETickableTickType UTPSVirtualBulletSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSVirtualBulletSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSVirtualBulletSubsystem, STATGROUP_Tickables);
+}
+
+void UTPSVirtualBulletSubsystem::SpawnBullet(AWeaponDefault* Weapon, int32 Archetype, const FVector& Location, const FVector& Velocity)
+{
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>();
+	const FTPSProjectileArchetype* myArchetype = myArchetypes ? myArchetypes->GetArchetype(Archetype) : nullptr;
+	if (!Weapon || !myArchetype)
+		return;
+
+	const int32 SettingIndex = FindSetting(Weapon, Archetype, myArchetype->Info.VirtualGravityScale);
+	Settings[SettingIndex].BulletsNum++;
+
+	const int32 Index = BulletsNum++;
+	const int32 LanesNum = Align(BulletsNum, 4);
+	TArray<float>* Lanes[] = { &PosX, &PosY, &PosZ, &VelX, &VelY, &VelZ, &GravityZ, &TimeLeft, &PrevX, &PrevY, &PrevZ };
+	for (TArray<float>* Lane : Lanes)
+	{
+		Lane->SetNumZeroed(LanesNum, false);
+	}
+
+	PosX[Index] = PrevX[Index] = Location.X;
+	PosY[Index] = PrevY[Index] = Location.Y;
+	PosZ[Index] = PrevZ[Index] = Location.Z;
+	VelX[Index] = Velocity.X;
+	VelY[Index] = Velocity.Y;
+	VelZ[Index] = Velocity.Z;
+	GravityZ[Index] = Settings[SettingIndex].GravityZ;
+	//actor projectile with life time 0 live until hit, virtual one need end to be removed
+	TimeLeft[Index] = myArchetype->Info.ProjectileLifeTime > 0.0f ? myArchetype->Info.ProjectileLifeTime : FMath::Max(VirtualBulletMaxLifeTime, KINDA_SMALL_NUMBER);
+
+	FTPSVirtualBullet& myBullet = Bullets.AddDefaulted_GetRef();
+	myBullet.Setting = SettingIndex;
+	myBullet.Instigator = Weapon->GetInstigatorController();
+	myBullet.InstigatorPawn = Weapon->GetInstigator();
+
+	INC_DWORD_STAT(STAT_TPS_VirtualBullets);
+}
+
+int32 UTPSVirtualBulletSubsystem::FindSetting(AWeaponDefault* Weapon, int32 Archetype, float GravityScale)
+{
+	int32 FreeIndex = INDEX_NONE;
+	for (int32 i = 0; i < Settings.Num(); i++)
+	{
+		if (Settings[i].Weapon == Weapon && Settings[i].Archetype == Archetype)
+			return i;
+		if (FreeIndex == INDEX_NONE && Settings[i].BulletsNum == 0)
+			FreeIndex = i;
+	}
+
+	if (FreeIndex == INDEX_NONE)
+		FreeIndex = Settings.AddDefaulted();
+
+	FTPSVirtualBulletSetting& mySetting = Settings[FreeIndex];
+	mySetting.Archetype = Archetype;
+	mySetting.Weapon = Weapon;
+	mySetting.GravityZ = GetWorld()->GetGravityZ() * GravityScale;
+	return FreeIndex;
+}
+
+void UTPSVirtualBulletSubsystem::Integrate(float DeltaTime)
+{
+	const int32 LanesNum = PosX.Num();
+	FMemory::Memcpy(PrevX.GetData(), PosX.GetData(), LanesNum * sizeof(float));
+	FMemory::Memcpy(PrevY.GetData(), PosY.GetData(), LanesNum * sizeof(float));
+	FMemory::Memcpy(PrevZ.GetData(), PosZ.GetData(), LanesNum * sizeof(float));
+
+	float* myPosX = PosX.GetData();
+	float* myPosY = PosY.GetData();
+	float* myPosZ = PosZ.GetData();
+	float* myVelX = VelX.GetData();
+	float* myVelY = VelY.GetData();
+	float* myVelZ = VelZ.GetData();
+	float* myGravityZ = GravityZ.GetData();
+	float* myTimeLeft = TimeLeft.GetData();
+
+	//4 bullets per register, velocity first (semi implicit euler)
+	const VectorRegister myDeltaTime = VectorSetFloat1(DeltaTime);
+	for (int32 i = 0; i < LanesNum; i += 4)
+	{
+		const VectorRegister NewVelZ = VectorMultiplyAdd(VectorLoad(myGravityZ + i), myDeltaTime, VectorLoad(myVelZ + i));
+		VectorStore(NewVelZ, myVelZ + i);
+
+		VectorStore(VectorMultiplyAdd(VectorLoad(myVelX + i), myDeltaTime, VectorLoad(myPosX + i)), myPosX + i);
+		VectorStore(VectorMultiplyAdd(VectorLoad(myVelY + i), myDeltaTime, VectorLoad(myPosY + i)), myPosY + i);
+		VectorStore(VectorMultiplyAdd(NewVelZ, myDeltaTime, VectorLoad(myPosZ + i)), myPosZ + i);
+		VectorStore(VectorSubtract(VectorLoad(myTimeLeft + i), myDeltaTime), myTimeLeft + i);
+	}
+}
+
+void UTPSVirtualBulletSubsystem::SweepBullets()
+{
+	UWorld* myWorld = GetWorld();
+	const ECollisionChannel myChannel = UEngineTypes::ConvertToCollisionChannel(ETraceTypeQuery::TraceTypeQuery4);
+	const FCollisionShape myShape = FCollisionShape::MakeSphere(FMath::Max(VirtualBulletRadius, 0.0f));
+
+	FCollisionQueryParams myParams(SCENE_QUERY_STAT(TPSVirtualBullet), false);
+	myParams.bReturnPhysicalMaterial = true;
+
+	//backward, removed bullet is replaced by already swept last one
+	for (int32 i = BulletsNum - 1; i >= 0; i--)
+	{
+		const FTPSVirtualBullet& myBullet = Bullets[i];
+		myParams.ClearIgnoredActors();
+		myParams.AddIgnoredActor(Settings[myBullet.Setting].Weapon.Get());
+		myParams.AddIgnoredActor(myBullet.InstigatorPawn.Get());
+
+		FHitResult Hit;
+		const FVector Start(PrevX[i], PrevY[i], PrevZ[i]);
+		const FVector End(PosX[i], PosY[i], PosZ[i]);
+		INC_DWORD_STAT(STAT_TPS_VirtualBulletSweeps);
+		if (myWorld->SweepSingleByChannel(Hit, Start, End, FQuat::Identity, myChannel, myShape, myParams))
+		{
+			INC_DWORD_STAT(STAT_TPS_VirtualBulletHits);
+			ResolveHit(i, Hit);
+			RemoveBullet(i);
+		}
+		else if (TimeLeft[i] <= 0.0f)
+		{
+			RemoveBullet(i);
+		}
+	}
+}
+
+void UTPSVirtualBulletSubsystem::ResolveHit(int32 Index, const FHitResult& Hit)
+{
+	const FTPSVirtualBullet myBullet = Bullets[Index];
+	//copy, damage can spawn bullets and grow Settings
+	const TWeakObjectPtr<AWeaponDefault> myWeapon = Settings[myBullet.Setting].Weapon;
+	//archetype is not removed while world live
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>();
+	const FTPSProjectileArchetype& myArchetype = *myArchetypes->GetArchetype(Settings[myBullet.Setting].Archetype);
+	const float myDamage = myArchetype.Info.ProjectileDamage * UTPSHitProxyComponent::GetDamageMultiplier(Hit);
+	const TSubclassOf<UTPS_StateEffect> myEffect = myArchetype.Info.Effect;
+	AActor* myHitActor = Hit.GetActor();
+
+	if (myHitActor && Hit.PhysMaterial.IsValid())
+	{
+		EPhysicalSurface mySurfacetype = UGameplayStatics::GetSurfaceType(Hit);
+
+		//fx of weapon setting, nobody to send it if weapon is destroyed
+		if (myWeapon.IsValid())
+		{
+			FTPSShotImpact& myImpact = PendingImpacts.FindOrAdd(myWeapon).AddDefaulted_GetRef();
+			myImpact.ImpactPoint = Hit.ImpactPoint;
+			myImpact.ImpactNormal = Hit.ImpactNormal;
+			myImpact.SurfaceType = mySurfacetype;
+			myImpact.HitComponent = Hit.GetComponent();
+		}
+
+		UTypes::AddEffectBySurfaceType(myHitActor, UTPSHitProxyComponent::GetHitBoneName(Hit), myEffect, mySurfacetype);
+	}
+	UGameplayStatics::ApplyPointDamage(myHitActor, myDamage, Hit.TraceStart, Hit, myBullet.Instigator.Get(), myWeapon.Get(), NULL);
+	UAISense_Damage::ReportDamageEvent(GetWorld(), myHitActor, myBullet.InstigatorPawn.Get(), myDamage, Hit.Location, Hit.Location);
+}
+
+void UTPSVirtualBulletSubsystem::RemoveBullet(int32 Index)
+{
+	FTPSVirtualBulletSetting& mySetting = Settings[Bullets[Index].Setting];
+	if (--mySetting.BulletsNum <= 0)
+	{
+		mySetting.BulletsNum = 0;
+		mySetting.Weapon = nullptr;
+	}
+
+	const int32 LastIndex = BulletsNum - 1;
+	TArray<float>* Lanes[] = { &PosX, &PosY, &PosZ, &VelX, &VelY, &VelZ, &GravityZ, &TimeLeft, &PrevX, &PrevY, &PrevZ };
+	for (TArray<float>* Lane : Lanes)
+	{
+		(*Lane)[Index] = (*Lane)[LastIndex];
+		(*Lane)[LastIndex] = 0.0f;
+	}
+	Bullets.RemoveAtSwap(Index, 1, false);
+	BulletsNum--;
+	DEC_DWORD_STAT(STAT_TPS_VirtualBullets);
+
+	const int32 LanesNum = Align(BulletsNum, 4);
+	for (TArray<float>* Lane : Lanes)
+	{
+		Lane->SetNum(LanesNum, false);
+	}
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "../FuncLibrary/Types.h"
+#include "TPSVirtualBulletSubsystem.generated.h"
+
+class AWeaponDefault;
+
+//archetype shared by bullets of one weapon, weapon can be destroyed before its bullets
+USTRUCT()
+struct FTPSVirtualBulletSetting
+{
+	GENERATED_BODY()
+
+	//index in UTPSProjectileArchetypeSubsystem
+	int32 Archetype = INDEX_NONE;
+	UPROPERTY()
+	TWeakObjectPtr<AWeaponDefault> Weapon;
+	float GravityZ = 0.0f;
+	int32 BulletsNum = 0;
+};
+
+//cold bullet data, used only on hit
+struct FTPSVirtualBullet
+{
+	int32 Setting = INDEX_NONE;
+	TWeakObjectPtr<AController> Instigator;
+	TWeakObjectPtr<APawn> InstigatorPawn;
+};
+
+/**
+ * Server simulation of projectiles with EProjectileSimulation::Virtual, bullet is not an actor. Position, velocity and
+ * life time are kept in float arrays padded to 4 and integrated together by vector registers, then every bullet sweep
+ * from old to new position. Hit apply same damage and effect as AProjectileDefault, fx go by weapon ShotImpacts_Multicast.
+ */
+UCLASS()
+class TPS_API UTPSVirtualBulletSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	void SpawnBullet(AWeaponDefault* Weapon, int32 Archetype, const FVector& Location, const FVector& Velocity);
+
+	UFUNCTION(BlueprintCallable, Category = "VirtualBullet")
+	int32 GetBulletsNum() const { return BulletsNum; }
+
+protected:
+	int32 FindSetting(AWeaponDefault* Weapon, int32 Archetype, float GravityScale);
+	void Integrate(float DeltaTime);
+	void SweepBullets();
+	void ResolveHit(int32 Index, const FHitResult& Hit);
+	void RemoveBullet(int32 Index);
+
+	//SoA, Num is BulletsNum aligned to 4, padding is zero
+	TArray<float> PosX;
+	TArray<float> PosY;
+	TArray<float> PosZ;
+	TArray<float> VelX;
+	TArray<float> VelY;
+	TArray<float> VelZ;
+	TArray<float> GravityZ;
+	TArray<float> TimeLeft;
+	//position before step
+	TArray<float> PrevX;
+	TArray<float> PrevY;
+	TArray<float> PrevZ;
+
+	TArray<FTPSVirtualBullet> Bullets;
+	int32 BulletsNum = 0;
+
+	UPROPERTY()
+	TArray<FTPSVirtualBulletSetting> Settings;
+
+	//hit fx of frame, one multicast per weapon
+	TMap<TWeakObjectPtr<AWeaponDefault>, TArray<FTPSShotImpact>> PendingImpacts;
+};
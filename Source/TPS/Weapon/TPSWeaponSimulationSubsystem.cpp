@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TPSWeaponSimulationSubsystem.h"
+#include "WeaponDefault.h"
+#include "Engine/World.h"
+#include "../TPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("WeaponSimulation Tick"), STAT_TPS_WeaponSimulationTick, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Weapons Active"), STAT_TPS_WeaponsActive, STATGROUP_TPS);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Weapons Registered"), STAT_TPS_WeaponsRegistered, STATGROUP_TPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon Sim Steps"), STAT_TPS_WeaponSimSteps, STATGROUP_TPS);
+
+float WeaponSimStepRate = 240.0f;
+FAutoConsoleVariableRef CVarWeaponSimStepRate(
+	TEXT("TPS.Weapon.SimStepRate"),
+	WeaponSimStepRate,
+	TEXT("Fixed steps per second of weapon simulation, independent of frame rate"),
+	ECVF_Default);
+
+int32 WeaponSimMaxSteps = 32;
+FAutoConsoleVariableRef CVarWeaponSimMaxSteps(
+	TEXT("TPS.Weapon.SimMaxSteps"),
+	WeaponSimMaxSteps,
+	TEXT("Max weapon simulation steps per frame, time of longer hitch is dropped"),
+	ECVF_Default);
+
+//DispersionReduction in weapon table is tuned as amount per frame at 60 fps
+static const float DispersionReductionRate = 60.0f;
+
+void UTPSWeaponSimulationSubsystem::Deinitialize()
+{
+	DEC_DWORD_STAT_BY(STAT_TPS_WeaponsActive, ActiveWeapons.Num());
+	DEC_DWORD_STAT_BY(STAT_TPS_WeaponsRegistered, Weapons.Num() - FreeIndices.Num());
+
+	Weapons.Empty();
+	IsActive.Empty();
+	ActiveWeapons.Empty();
+	FreeIndices.Empty();
+
+	Super::Deinitialize();
+}
+
+void UTPSWeaponSimulationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TPS_WeaponSimulationTick);
+
+	const float StepTime = 1.0f / FMath::Max(WeaponSimStepRate, 1.0f);
+	const int32 MaxSteps = FMath::Max(WeaponSimMaxSteps, 1);
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	StepAccumulator = FMath::Min(StepAccumulator + DeltaTime, StepTime * MaxSteps);
+	while (StepAccumulator >= StepTime)
+	{
+		StepAccumulator -= StepTime;
+		//world time at end of this step, frame time is end of last step plus remainder
+		StepEndTime = Now - StepAccumulator;
+		INC_DWORD_STAT(STAT_TPS_WeaponSimSteps);
+
+		//weapon can wake other weapons or self in simulate, new ones are simulated from next step
+		const int32 ActiveNum = ActiveWeapons.Num();
+		for (int32 i = 0; i < ActiveNum; i++)
+		{
+			SimulateWeapon(ActiveWeapons[i], StepTime);
+		}
+	}
+	ShotTime = -1.0f;
+
+	for (int32 i = ActiveWeapons.Num() - 1; i >= 0; i--)
+	{
+		const int32 SimIndex = ActiveWeapons[i];
+		AWeaponDefault* myWeapon = Weapons[SimIndex];
+		if (IsValid(myWeapon) && myWeapon->IsPredictingOwner())
+		{
+			myWeapon->PredictionResyncTick();
+		}
+
+		if (IsWeaponIdle(SimIndex))
+		{
+			IsActive[SimIndex] = false;
+			ActiveWeapons.RemoveAtSwap(i, 1, false);
+			DEC_DWORD_STAT(STAT_TPS_WeaponsActive);
+		}
+	}
+}
+
+bool UTPSWeaponSimulationSubsystem::IsTickable() const
+{
+	return ActiveWeapons.Num() > 0;
+}
+
+ETickableTickType UTPSWeaponSimulationSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+TStatId UTPSWeaponSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTPSWeaponSimulationSubsystem, STATGROUP_Tickables);
+}
+
+int32 UTPSWeaponSimulationSubsystem::RegisterWeapon(AWeaponDefault* Weapon)
+{
+	int32 SimIndex = INDEX_NONE;
+	if (FreeIndices.Num() > 0)
+	{
+		SimIndex = FreeIndices.Pop(false);
+		Weapons[SimIndex] = Weapon;
+	}
+	else
+	{
+		SimIndex = Weapons.Add(Weapon);
+		IsActive.Add(false);
+		FireTimer.AddZeroed();
+		ReloadTimer.AddZeroed();
+		DropClipTimer.AddZeroed();
+		DropShellTimer.AddZeroed();
+		Dispersion.AddZeroed();
+		DispersionMin.AddZeroed();
+		DispersionMax.AddZeroed();
+		DispersionRecoil.AddZeroed();
+		DispersionReduction.AddZeroed();
+		Flags.AddZeroed();
+	}
+
+	FireTimer[SimIndex] = 0.0f;
+	ReloadTimer[SimIndex] = 0.0f;
+	DropClipTimer[SimIndex] = -1.0f;
+	DropShellTimer[SimIndex] = -1.0f;
+	Dispersion[SimIndex] = 0.0f;
+	DispersionMin[SimIndex] = 0.1f;
+	DispersionMax[SimIndex] = 1.0f;
+	DispersionRecoil[SimIndex] = 0.1f;
+	DispersionReduction[SimIndex] = 0.1f;
+	Flags[SimIndex] = 0;
+
+	INC_DWORD_STAT(STAT_TPS_WeaponsRegistered);
+	return SimIndex;
+}
+
+void UTPSWeaponSimulationSubsystem::UnregisterWeapon(int32 SimIndex)
+{
+	if (!Weapons.IsValidIndex(SimIndex) || !Weapons[SimIndex])
+		return;
+
+	//can be called from simulation, active list is cleaned up in Tick as weapon is null
+	Weapons[SimIndex] = nullptr;
+	FreeIndices.Add(SimIndex);
+	DEC_DWORD_STAT(STAT_TPS_WeaponsRegistered);
+}
+
+void UTPSWeaponSimulationSubsystem::WakeWeapon(int32 SimIndex)
+{
+	if (IsActive.IsValidIndex(SimIndex) && !IsActive[SimIndex] && Weapons[SimIndex])
+	{
+		IsActive[SimIndex] = true;
+		ActiveWeapons.Add(SimIndex);
+		INC_DWORD_STAT(STAT_TPS_WeaponsActive);
+	}
+}
+
+void UTPSWeaponSimulationSubsystem::SimulateWeapon(int32 SimIndex, float DeltaTime)
+{
+	AWeaponDefault* myWeapon = Weapons[SimIndex];
+	if (!IsValid(myWeapon))
+		return;
+
+	//fire, shot add RateOfFire to timer so fast weapons can shoot several times in one step
+	if (myWeapon->WeaponFiring && myWeapon->GetWeaponRound() > 0 && !myWeapon->WeaponReloading)
+	{
+		FireTimer[SimIndex] -= DeltaTime;
+		const float MinRateOfFire = DeltaTime / MaxShotsPerStep;
+		int32 Shots = 0;
+		while (FireTimer[SimIndex] < 0.0f && Shots < MaxShotsPerStep && myWeapon->WeaponFiring && myWeapon->GetWeaponRound() > 0 && !myWeapon->WeaponReloading)
+		{
+			//timer went below zero at this moment inside the step
+			ShotTime = StepEndTime + FireTimer[SimIndex];
+			const float TimerBeforeShot = FireTimer[SimIndex];
+			if (myWeapon->HasAuthority())
+				myWeapon->Fire();
+			else
+				myWeapon->FirePredicted();
+			//weapon with zero RateOfFire
+			FireTimer[SimIndex] = FMath::Max(FireTimer[SimIndex], TimerBeforeShot + MinRateOfFire);
+			Shots++;
+		}
+		//stopped by rounds or state, don't keep debt of shots for later
+		FireTimer[SimIndex] = FMath::Max(FireTimer[SimIndex], 0.0f);
+		ShotTime = -1.0f;
+	}
+
+	//reload
+	if (myWeapon->WeaponReloading)
+	{
+		if (ReloadTimer[SimIndex] < 0.0f)
+		{
+			myWeapon->FinishReload();
+		}
+		else
+		{
+			ReloadTimer[SimIndex] -= DeltaTime;
+		}
+	}
+
+	//dispersion
+	if (!myWeapon->WeaponReloading)
+	{
+		float& myDispersion = Dispersion[SimIndex];
+		if (!myWeapon->WeaponFiring)
+		{
+			const float Reduction = DispersionReduction[SimIndex] * DispersionReductionRate * DeltaTime;
+			if (myWeapon->ShouldReduceDispersion)
+				myDispersion -= Reduction;
+			else
+				myDispersion += Reduction;
+		}
+		myDispersion = FMath::Clamp(myDispersion, DispersionMin[SimIndex], FMath::Max(DispersionMin[SimIndex], DispersionMax[SimIndex]));
+	}
+
+	//drop meshes
+	if (Flags[SimIndex] & WeaponSim_DropClip)
+	{
+		if (DropClipTimer[SimIndex] < 0.0f)
+		{
+			Flags[SimIndex] &= ~WeaponSim_DropClip;
+			myWeapon->DropClipMesh();
+		}
+		else
+		{
+			DropClipTimer[SimIndex] -= DeltaTime;
+		}
+	}
+	if (Flags[SimIndex] & WeaponSim_DropShell)
+	{
+		if (DropShellTimer[SimIndex] < 0.0f)
+		{
+			Flags[SimIndex] &= ~WeaponSim_DropShell;
+			myWeapon->DropShellMesh();
+		}
+		else
+		{
+			DropShellTimer[SimIndex] -= DeltaTime;
+		}
+	}
+}
+
+float UTPSWeaponSimulationSubsystem::GetShotTime() const
+{
+	return ShotTime >= 0.0f ? ShotTime : GetWorld()->GetTimeSeconds();
+}
+
+bool UTPSWeaponSimulationSubsystem::IsWeaponIdle(int32 SimIndex) const
+{
+	AWeaponDefault* myWeapon = Weapons[SimIndex];
+	if (!IsValid(myWeapon))
+		return true;
+
+	if (myWeapon->WeaponFiring || myWeapon->WeaponReloading || Flags[SimIndex] != 0)
+		return false;
+
+	if (myWeapon->IsPredictingOwner() && myWeapon->LocalShotSequence != myWeapon->ServerShotSequence)
+		return false;
+
+	//dispersion go to min or max bound and stay there
+	if (myWeapon->ShouldReduceDispersion)
+		return Dispersion[SimIndex] <= DispersionMin[SimIndex];
+	return Dispersion[SimIndex] >= DispersionMax[SimIndex] || DispersionMax[SimIndex] <= DispersionMin[SimIndex];
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TPSWeaponSimulationSubsystem.generated.h"
+
+class AWeaponDefault;
+
+//pending drop timers of weapon
+enum ETPSWeaponSimFlags : uint8
+{
+	WeaponSim_DropClip = 1 << 0,
+	WeaponSim_DropShell = 1 << 1,
+};
+
+/**
+ * Timers and dispersion of all weapons in arrays by weapon SimIndex. Only weapons with running timer (fire, reload, drop)
+ * or not settled dispersion are simulated, weapon actors don't tick.
+ * Simulation run in fixed steps (TPS.Weapon.SimStepRate), several per frame if needed, so rate of fire and dispersion
+ * don't depend on frame rate.
+ */
+UCLASS()
+class TPS_API UTPSWeaponSimulationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+	//End FTickableGameObject
+
+	int32 RegisterWeapon(AWeaponDefault* Weapon);
+	void UnregisterWeapon(int32 SimIndex);
+	//weapon state changed, simulate it until it is idle again
+	void WakeWeapon(int32 SimIndex);
+
+	UFUNCTION(BlueprintCallable, Category = "WeaponSimulation")
+	int32 GetActiveWeaponsNum() const { return ActiveWeapons.Num(); }
+
+	//world time of shot being fired by simulation, current world time outside of it
+	float GetShotTime() const;
+
+	//state by SimIndex
+	TArray<float> FireTimer;
+	TArray<float> ReloadTimer;
+	TArray<float> DropClipTimer;
+	TArray<float> DropShellTimer;
+	TArray<float> Dispersion;
+	TArray<float> DispersionMin;
+	TArray<float> DispersionMax;
+	TArray<float> DispersionRecoil;
+	TArray<float> DispersionReduction;
+	TArray<uint8> Flags;
+
+protected:
+	void SimulateWeapon(int32 SimIndex, float DeltaTime);
+	bool IsWeaponIdle(int32 SimIndex) const;
+
+	UPROPERTY()
+	TArray<AWeaponDefault*> Weapons;
+	TArray<bool> IsActive;
+	TArray<int32> ActiveWeapons;
+	TArray<int32> FreeIndices;
+
+	//not simulated frame time, less than one step
+	float StepAccumulator = 0.0f;
+	float StepEndTime = 0.0f;
+	float ShotTime = -1.0f;
+
+	static const int32 MaxShotsPerStep = 16;
+};
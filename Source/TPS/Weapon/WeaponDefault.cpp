@@ -2,10 +2,23 @@
 #include "DrawDebugHelpers.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/GameplayStatics.h"
-#include "Engine/StaticMeshActor.h"
 #include "Engine/GameEngine.h"
 #include "../Character/TPSInventoryComponent.h"
+#include "../Character/TPSHitProxyComponent.h"
+#include "../Game/TPSGameInstance.h"
+#include "TPSProjectilePoolSubsystem.h"
+#include "TPSVirtualBulletSubsystem.h"
+#include "TPSProjectileArchetypeSubsystem.h"
+#include "TPSPelletBroadphase.h"
+#include "ProjectileDefault_Grenade.h"
+#include "TPSDropMeshSubsystem.h"
+#include "TPSWeaponSimulationSubsystem.h"
+#include "../Game/TPSLagCompensationSubsystem.h"
+#include "GameFramework/GameStateBase.h"
 #include "Net/UnrealNetwork.h"
+#include "Engine/NetSerialization.h"
+#include "Misc/AutomationTest.h"
+#include "../TPS.h"
 
 int32 DebugWeaponShow = 0;
 FAutoConsoleVariableRef CVarWeaponShow(
@@ -14,11 +27,46 @@ FAutoConsoleVariableRef CVarWeaponShow(
 	TEXT("Draw Debug for Weapon"),
 	ECVF_Cheat);
 
+int32 WeaponPredictFire = 1;
+FAutoConsoleVariableRef CVarWeaponPredictFire(
+	TEXT("TPS.Weapon.PredictFire"),
+	WeaponPredictFire,
+	TEXT("Owning client fire weapon locally (fx and rounds) without wait server"),
+	ECVF_Default);
+
+float WeaponPredictResyncTime = 1.0f;
+FAutoConsoleVariableRef CVarWeaponPredictResyncTime(
+	TEXT("TPS.Weapon.PredictResyncTime"),
+	WeaponPredictResyncTime,
+	TEXT("Time after last predicted shot when not confirmed shots are dropped and rounds taken from server"),
+	ECVF_Default);
+
+int32 ProjectileLocalCosmetic = 1;
+FAutoConsoleVariableRef CVarProjectileLocalCosmetic(
+	TEXT("TPS.Projectile.LocalCosmetic"),
+	ProjectileLocalCosmetic,
+	TEXT("Not explosive projectiles are not replicated, clients spawn local copies by one shot event"),
+	ECVF_Default);
+
+int32 WeaponPelletBroadphase = 1;
+FAutoConsoleVariableRef CVarWeaponPelletBroadphase(
+	TEXT("TPS.Weapon.PelletBroadphase"),
+	WeaponPelletBroadphase,
+	TEXT("Hitscan shot with several pellets test rays against movable bounds first, other rays trace static world only"),
+	ECVF_Default);
+
+float ProjectileCosmeticMaxForwardTime = 0.1f;
+FAutoConsoleVariableRef CVarProjectileCosmeticMaxForwardTime(
+	TEXT("TPS.Projectile.CosmeticMaxForwardTime"),
+	ProjectileCosmeticMaxForwardTime,
+	TEXT("Max time client cosmetic projectile is moved forward for shot event latency"),
+	ECVF_Default);
+
 // Sets default values
 AWeaponDefault::AWeaponDefault()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	//timers are simulated by UTPSWeaponSimulationSubsystem
+	PrimaryActorTick.bCanEverTick = false;
 
 	SetReplicates(true);
 
@@ -44,131 +92,177 @@ void AWeaponDefault::BeginPlay()
 {
 	Super::BeginPlay();
 
+	HitscanTraceDelegate.BindUObject(this, &AWeaponDefault::OnHitscanTraceDone);
+
+	if (HasAuthority())
+		DispersionSeed = FMath::Rand();
+
+	WeaponSimulation = GetWorld()->GetSubsystem<UTPSWeaponSimulationSubsystem>();
+	if (WeaponSimulation)
+		SimIndex = WeaponSimulation->RegisterWeapon(this);
+
 	WeaponInit();
 }
 
-// Called every frame
-void AWeaponDefault::Tick(float DeltaTime)
+void AWeaponDefault::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+	if (myGI && !StreamedWeaponName.IsNone())
+	{
+		myGI->ReleaseWeaponAssets(StreamedWeaponName);
+		StreamedWeaponName = NAME_None;
+	}
+
+	if (WeaponSimulation)
+	{
+		WeaponSimulation->UnregisterWeapon(SimIndex);
+		SimIndex = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
 
-	FireTick(DeltaTime);
-	ReloadTick(DeltaTime);
-	DispersionTick(DeltaTime);
-	ClipDropTick(DeltaTime);
-	ShellDropTick(DeltaTime);
+void AWeaponDefault::WakeSimulation()
+{
+	if (WeaponSimulation)
+		WeaponSimulation->WakeWeapon(SimIndex);
 }
 
-void AWeaponDefault::FireTick(float DeltaTime)
+void AWeaponDefault::PredictionResyncTick()
 {
-	if (WeaponFiring && GetWeaponRound() > 0 && !WeaponReloading)
+	//server never fired some predicted shots (rejected or ammo was wrong), take rounds from server
+	if (!WeaponFiring && LocalShotSequence != ServerShotSequence && GetWorld()->GetTimeSeconds() - LastPredictedShotTime > WeaponPredictResyncTime)
 	{
-		if (FireTimer < 0.f)
-		{
-			Fire();
-		}
-		else
-		{
-			FireTimer -= DeltaTime;
-		}
+		LocalShotSequence = ServerShotSequence;
+		AdditionalWeaponInfo.Round = ServerRound;
 	}
 }
 
-void AWeaponDefault::ReloadTick(float DeltaTime)
+void AWeaponDefault::DropClipMesh()
+{
+	InitDropMesh_OnServer(WeaponSetting.ClipDropMesh.DropMesh.Get(), WeaponSetting.ClipDropMesh.DropMeshOffset, WeaponSetting.ClipDropMesh.DropMeshImpulseDir, WeaponSetting.ClipDropMesh.DropMeshLifeTime, WeaponSetting.ClipDropMesh.ImpulseRandomDispersion, WeaponSetting.ClipDropMesh.PowerImpulse, WeaponSetting.ClipDropMesh.CustomMass);
+}
+
+void AWeaponDefault::DropShellMesh()
+{
+	InitDropMesh_OnServer(WeaponSetting.ShellBullets.DropMesh.Get(), WeaponSetting.ShellBullets.DropMeshOffset, WeaponSetting.ShellBullets.DropMeshImpulseDir, WeaponSetting.ShellBullets.DropMeshLifeTime, WeaponSetting.ShellBullets.ImpulseRandomDispersion, WeaponSetting.ShellBullets.PowerImpulse, WeaponSetting.ShellBullets.CustomMass);
+}
+
+void AWeaponDefault::WeaponInit()
 {
-	if (WeaponReloading)
+	if (SkeletalMeshWeapon && !SkeletalMeshWeapon->SkeletalMesh)
 	{
-		if (ReloadTimer < 0.0f)
-		{
-			FinishReload();
-		}
-		else
-		{
-			ReloadTimer -= DeltaTime;
-		}
+		SkeletalMeshWeapon->DestroyComponent(true);
 	}
+
+	if (StaticMeshWeapon && !StaticMeshWeapon->GetStaticMesh())
+	{
+		StaticMeshWeapon->DestroyComponent();
+	}
+	UpdateStateWeapon_OnServer(EMovementState::Run_State);
 }
 
-void AWeaponDefault::DispersionTick(float DeltaTime)
+void AWeaponDefault::SetWeaponActive(bool bActive)
 {
-	if (!WeaponReloading)
+	if (!bActive)
 	{
-		if (!WeaponFiring)
-		{
-			if (ShouldReduceDispersion)
-			{
-				CurrentDispersion = CurrentDispersion - CurrentDispersionReduction;
-			}
-			else
-			{
-				CurrentDispersion = CurrentDispersion + CurrentDispersionReduction;
-			}
-		}
+		WeaponFiring = false;
+		if (WeaponReloading)
+			CancelReload();
+	}
 
-		if (CurrentDispersion < CurrentDispersionMin)
-		{
-			CurrentDispersion = CurrentDispersionMin;
-		}
-		else
-		{
-			if (CurrentDispersion > CurrentDispersionMax)
-			{
-				CurrentDispersion = CurrentDispersionMax;
-			}
-		}
+	SetActorHiddenInGame(!bActive);
+	if (bActive)
+	{
+		SetNetDormancy(DORM_Awake);
+		ForceNetUpdate();
+	}
+	else
+	{
+		//hidden state still go to clients with last update before dormancy
+		SetNetDormancy(DORM_DormantAll);
 	}
-	if (ShowDebug)
-		UE_LOG(LogTemp, Warning, TEXT("Dispersion: MAX = %f. MIN = %f. Current = %f"), CurrentDispersionMax, CurrentDispersionMin, CurrentDispersion);
 }
 
-void AWeaponDefault::ClipDropTick(float DeltaTime)
+void AWeaponDefault::WarmUpProjectilePool()
 {
-	if (DropClipFlag)
+	if (HasAuthority() && WeaponSetting.ProjectileSetting.Projectile.Get() && !IsVirtualProjectile())
 	{
-		if (DropClipTimer < 0.0f)
-		{
-			DropClipFlag = false;
-			InitDropMesh_OnServer(WeaponSetting.ClipDropMesh.DropMesh, WeaponSetting.ClipDropMesh.DropMeshOffset, WeaponSetting.ClipDropMesh.DropMeshImpulseDir, WeaponSetting.ClipDropMesh.DropMeshLifeTime, WeaponSetting.ClipDropMesh.ImpulseRandomDispersion, WeaponSetting.ClipDropMesh.PowerImpulse, WeaponSetting.ClipDropMesh.CustomMass);
-		}
-		else
+		UTPSProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UTPSProjectilePoolSubsystem>();
+		if (myPool)
 		{
-			DropClipTimer -= DeltaTime;
+			myPool->WarmUp(WeaponSetting.ProjectileSetting.Projectile.Get(), GetNumberProjectileByShot(), !IsLocalCosmeticProjectile());
 		}
 	}
 }
 
-void AWeaponDefault::ShellDropTick(float DeltaTime)
+void AWeaponDefault::RequestWeaponAssets()
+{
+	if (StreamedWeaponName == IdWeaponName)
+		return;
+
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+	if (!myGI)
+		return;
+
+	if (!StreamedWeaponName.IsNone())
+		myGI->ReleaseWeaponAssets(StreamedWeaponName);
+	StreamedWeaponName = IdWeaponName;
+	bWeaponAssetsLoaded = false;
+	ProjectileArchetype = INDEX_NONE;
+
+	myGI->RequestWeaponAssets(StreamedWeaponName);
+	myGI->CallWhenWeaponAssetsLoaded(StreamedWeaponName, FStreamableDelegate::CreateUObject(this, &AWeaponDefault::OnWeaponAssetsLoaded));
+}
+
+void AWeaponDefault::OnWeaponAssetsLoaded()
 {
-	if (DropShellFlag)
+	bWeaponAssetsLoaded = true;
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>();
+	if (myArchetypes)
+		ProjectileArchetype = myArchetypes->InternArchetype(IdWeaponName, WeaponSetting.ProjectileSetting);
+	WarmUpProjectilePool();
+
+	if (bFireOnAssetsLoaded)
 	{
-		if (DropShellTimer < 0.0f)
+		bFireOnAssetsLoaded = false;
+		if (HasAuthority())
 		{
-			DropShellFlag = false;
-			InitDropMesh_OnServer(WeaponSetting.ShellBullets.DropMesh, WeaponSetting.ShellBullets.DropMeshOffset, WeaponSetting.ShellBullets.DropMeshImpulseDir, WeaponSetting.ShellBullets.DropMeshLifeTime, WeaponSetting.ShellBullets.ImpulseRandomDispersion, WeaponSetting.ShellBullets.PowerImpulse, WeaponSetting.ShellBullets.CustomMass);
+			SetWeaponStateFire_OnServer_Implementation(true);
 		}
-		else
+		else if (IsPredictingOwner())
 		{
-			DropShellTimer -= DeltaTime;
+			WeaponFiring = CheckWeaponCanFire();
+			if (WeaponSimulation)
+				WeaponSimulation->FireTimer[SimIndex] = 0.01f;
+			WakeSimulation();
 		}
 	}
 }
 
-void AWeaponDefault::WeaponInit()
+void AWeaponDefault::SetWeaponStateFire(bool bIsFire)
 {
-	if (SkeletalMeshWeapon && !SkeletalMeshWeapon->SkeletalMesh)
+	if (IsPredictingOwner())
 	{
-		SkeletalMeshWeapon->DestroyComponent(true);
+		bFireOnAssetsLoaded = bIsFire && !bWeaponAssetsLoaded;
+		//same as server do, so local shots go with server cadence
+		WeaponFiring = bIsFire && CheckWeaponCanFire();
+		if (WeaponSimulation)
+			WeaponSimulation->FireTimer[SimIndex] = 0.01f;
+		WakeSimulation();
 	}
+	SetWeaponStateFire_OnServer(bIsFire);
+}
 
-	if (StaticMeshWeapon && !StaticMeshWeapon->GetStaticMesh())
-	{
-		StaticMeshWeapon->DestroyComponent();
-	}
-	UpdateStateWeapon_OnServer(EMovementState::Run_State);
+bool AWeaponDefault::IsPredictingOwner() const
+{
+	APawn* myPawn = Cast<APawn>(GetOwner());
+	return WeaponPredictFire && !HasAuthority() && myPawn && myPawn->IsLocallyControlled();
 }
 
 void AWeaponDefault::SetWeaponStateFire_OnServer_Implementation(bool bIsFire)
 {
+	bFireOnAssetsLoaded = bIsFire && !bWeaponAssetsLoaded;
 	if (CheckWeaponCanFire())
 	{
 		WeaponFiring = bIsFire;
@@ -177,12 +271,14 @@ void AWeaponDefault::SetWeaponStateFire_OnServer_Implementation(bool bIsFire)
 	{
 		WeaponFiring = false;
 	}
-	FireTimer = 0.01f;//!!!!!
+	if (WeaponSimulation)
+		WeaponSimulation->FireTimer[SimIndex] = 0.01f;//!!!!!
+	WakeSimulation();
 }
 
 bool AWeaponDefault::CheckWeaponCanFire()
 {
-	return !BlockFire;
+	return !BlockFire && bWeaponAssetsLoaded;
 }
 
 FProjectileInfo AWeaponDefault::GetProjectile()
@@ -190,6 +286,22 @@ FProjectileInfo AWeaponDefault::GetProjectile()
 	return WeaponSetting.ProjectileSetting;
 }
 
+bool AWeaponDefault::IsVirtualProjectile() const
+{
+	const FProjectileInfo& ProjectileInfo = WeaponSetting.ProjectileSetting;
+	UClass* myProjectileClass = ProjectileInfo.Projectile.Get();
+	return ProjectileInfo.Simulation == EProjectileSimulation::Virtual && myProjectileClass
+		&& !myProjectileClass->IsChildOf(AProjectileDefault_Grenade::StaticClass());
+}
+
+bool AWeaponDefault::IsLocalCosmeticProjectile() const
+{
+	const FProjectileInfo& ProjectileInfo = WeaponSetting.ProjectileSetting;
+	UClass* myProjectileClass = ProjectileInfo.Projectile.Get();
+	return ProjectileLocalCosmetic && myProjectileClass && !IsVirtualProjectile()
+		&& !myProjectileClass->IsChildOf(AProjectileDefault_Grenade::StaticClass());
+}
+
 void AWeaponDefault::Fire()
 {
 	//On server
@@ -197,38 +309,35 @@ void AWeaponDefault::Fire()
 	UAnimMontage* AnimToPlay = nullptr;
 	if (WeaponAiming)
 	{
-		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharFireAim;
+		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharFireAim.Get();
 	}
 	else
 	{
-		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharFire;
-	}
-
-	if (WeaponSetting.AnimWeaponInfo.AnimWeaponFire)
-	{
-		AnimWeaponStart_Multicast(WeaponSetting.AnimWeaponInfo.AnimWeaponFire);
+		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharFire.Get();
 	}
 
-	if (WeaponSetting.ShellBullets.DropMesh)
+	if (!WeaponSetting.ShellBullets.DropMesh.IsNull())
 	{
 		if (WeaponSetting.ShellBullets.DropMeshTime < 0.0f)
 		{
-			InitDropMesh_OnServer(WeaponSetting.ShellBullets.DropMesh, WeaponSetting.ShellBullets.DropMeshOffset, WeaponSetting.ShellBullets.DropMeshImpulseDir, WeaponSetting.ShellBullets.DropMeshLifeTime, WeaponSetting.ShellBullets.ImpulseRandomDispersion, WeaponSetting.ShellBullets.PowerImpulse, WeaponSetting.ShellBullets.CustomMass);
+			InitDropMesh_OnServer(WeaponSetting.ShellBullets.DropMesh.Get(), WeaponSetting.ShellBullets.DropMeshOffset, WeaponSetting.ShellBullets.DropMeshImpulseDir, WeaponSetting.ShellBullets.DropMeshLifeTime, WeaponSetting.ShellBullets.ImpulseRandomDispersion, WeaponSetting.ShellBullets.PowerImpulse, WeaponSetting.ShellBullets.CustomMass);
 		}
-		else
+		else if (WeaponSimulation)
 		{
-			DropShellFlag = true;
-			DropShellTimer = WeaponSetting.ShellBullets.DropMeshTime;
+			WeaponSimulation->Flags[SimIndex] |= WeaponSim_DropShell;
+			WeaponSimulation->DropShellTimer[SimIndex] = WeaponSetting.ShellBullets.DropMeshTime;
 		}
 	}
 
-	FireTimer = WeaponSetting.RateOfFire;
+	if (WeaponSimulation)
+		WeaponSimulation->FireTimer[SimIndex] += WeaponSetting.RateOfFire;
 	AdditionalWeaponInfo.Round = AdditionalWeaponInfo.Round - 1;
+	ServerShotSequence++;
 	ChangeDispersionByShot();
 
 	OnWeaponFireStart.Broadcast(AnimToPlay);
 
-	FXWeaponFire_Multicast(WeaponSetting.EffectFireWeapon, WeaponSetting.SoundFireWeapon);
+	FXWeaponFire_Multicast(WeaponSetting.EffectFireWeapon.Get(), WeaponSetting.SoundFireWeapon.Get(), WeaponSetting.AnimWeaponInfo.AnimWeaponFire.Get());
 
 	int8 NumberProjectile = GetNumberProjectileByShot();
 
@@ -236,86 +345,95 @@ void AWeaponDefault::Fire()
 	{
 		FVector SpawnLocation = ShootLocation->GetComponentLocation();
 		FRotator SpawnRotation = ShootLocation->GetComponentRotation();
-		FProjectileInfo ProjectileInfo;
-		ProjectileInfo = GetProjectile();
+		const FProjectileInfo& ProjectileInfo = WeaponSetting.ProjectileSetting;
+
+		//trace hits of all pellets go to clients by one multicast
+		TArray<FTPSShotImpact> ShotImpacts;
+		TArray<FVector> TraceEnds;
+
+		UTPSVirtualBulletSubsystem* myVirtualBullets = IsVirtualProjectile() ? GetWorld()->GetSubsystem<UTPSVirtualBulletSubsystem>() : nullptr;
+		const bool bLocalCosmetic = IsLocalCosmeticProjectile();
+		FTPSProjectileShot ProjectileShot;
+
+		//same pellets on every machine with same seed, shot number and dispersion
+		TArray<FVector> ShotDirections;
+		MakeShotDirections(DispersionSeed, ServerShotSequence, GetShotDirection(), GetCurrentDispersion(), NumberProjectile, ShotDirections);
 
-		FVector EndLocation;
 		for (int8 i = 0; i < NumberProjectile; i++)
 		{
-			EndLocation = GetFireEndLocation();
+			const FVector Dir = ShotDirections[i];
 
+#if ENABLE_DRAW_DEBUG
 			if (ShowDebug)
 			{
 				DrawDebugLine(GetWorld(), SpawnLocation, SpawnLocation + ShootLocation->GetForwardVector() * WeaponSetting.DistacneTrace,
 					FColor::Green, false, 5.f, (uint8)'\000', 0.5f);
 			}
+#endif
 
-			if (ProjectileInfo.Projectile)
+			if (!ProjectileInfo.Projectile.IsNull())
 			{
 				//Projectile Init ballistic fire
-				FVector Dir = EndLocation - SpawnLocation;
-
-				Dir.Normalize();
+				if (myVirtualBullets)
+				{
+					myVirtualBullets->SpawnBullet(this, ProjectileArchetype, SpawnLocation, Dir * ProjectileInfo.ProjectileInitSpeed);
+					continue;
+				}
 
 				FMatrix myMatrix(Dir, FVector(0, 1, 0), FVector(0, 0, 1), FVector::ZeroVector);
 				SpawnRotation = myMatrix.Rotator();
 
-				FActorSpawnParameters SpawnParams;
-				SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-				SpawnParams.Owner = GetOwner();
-				SpawnParams.Instigator = GetInstigator();
-
-				AProjectileDefault* myProjectile = Cast<AProjectileDefault>(GetWorld()->SpawnActor(ProjectileInfo.Projectile, &SpawnLocation, &SpawnRotation, SpawnParams));
-				if (myProjectile)
+				AProjectileDefault* myProjectile = nullptr;
+				UTPSProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UTPSProjectilePoolSubsystem>();
+				if (myPool)
 				{
-					myProjectile->InitProjectile(ProjectileInfo);
-					//myProjectile->BulletProjectileMovement->InitialSpeed = ProjectileInfo.ProjectileInitSpeed;
-					//myProjectile->BulletProjectileMovement->Velocity = Dir * ProjectileInfo.ProjectileInitSpeed;
-					Projectile_Multicast(myProjectile, Dir, ProjectileInfo.ProjectileInitSpeed);
+					myProjectile = myPool->AcquireProjectile(ProjectileInfo.Projectile.Get(), SpawnLocation, SpawnRotation, GetOwner(), GetInstigator(), !bLocalCosmetic);
 				}
-			}
-			else
-			{
-				FHitResult Hit;
-				TArray<AActor*> Actors;
-
-				UKismetSystemLibrary::LineTraceSingle(GetWorld(), SpawnLocation, EndLocation * WeaponSetting.DistacneTrace,
-					ETraceTypeQuery::TraceTypeQuery4, false, Actors, EDrawDebugTrace::ForDuration, Hit, true, FLinearColor::Red, FLinearColor::Green, 5.0f);
-
-				if (Hit.GetActor() && Hit.PhysMaterial.IsValid())
+				if (myProjectile)
 				{
-					//FXShotgunHitDecal_Multicast(UMaterialInterface * DecalMaterial, UPrimitiveComponent * OtherComp, FHitResult HitResult);
-					EPhysicalSurface mySurfacetype = UGameplayStatics::GetSurfaceType(Hit);
-
-					if (WeaponSetting.ProjectileSetting.HitDecals.Contains(mySurfacetype))
+					myProjectile->InitProjectileArchetype(ProjectileArchetype);
+					if (bLocalCosmetic)
 					{
-						UMaterialInterface* myMaterial = WeaponSetting.ProjectileSetting.HitDecals[mySurfacetype];
-						if (myMaterial && Hit.GetComponent())
-						{
-							ShotgunHitDecal_Multicast(myMaterial, Hit.GetComponent(), Hit);
-							//UGameplayStatics::SpawnDecalAttached(myMaterial, FVector(20.0f), Hit.GetComponent(), NAME_None, Hit.ImpactPoint, Hit.ImpactNormal.Rotation(), EAttachLocation::KeepWorldPosition);
-						}
+						Projectile_Multicast_Implementation(myProjectile, SpawnLocation, Dir, ProjectileInfo.ProjectileInitSpeed);
+						ProjectileShot.Directions.Add(Dir);
 					}
-					if (WeaponSetting.ProjectileSetting.HitFXs.Contains(mySurfacetype))
+					else
 					{
-						UParticleSystem* myParticle = WeaponSetting.ProjectileSetting.HitFXs[mySurfacetype];
-						if (myParticle)
-						{
-							ShotgunHitFX_Multicast(myParticle, Hit);
-							//UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), myParicle, FTransform(Hit.ImpactNormal.Rotation(), Hit.ImpactPoint, FVector(1.0f)));
-						}
-					}
-					if (WeaponSetting.ProjectileSetting.HitSound)
-					{
-						ShotgunHitSound_Multicast(WeaponSetting.ProjectileSetting.HitSound, Hit);
-						//UGameplayStatics::PlaySoundAtLocation(GetWorld(), WeaponSetting.ProjectileSetting.HitSound, Hit.ImpactPoint);
+						Projectile_Multicast(myProjectile, SpawnLocation, Dir, ProjectileInfo.ProjectileInitSpeed);
 					}
+				}
+			}
+			else
+			{
+				const FVector TraceEnd = SpawnLocation + Dir * WeaponSetting.DistacneTrace;
+				TraceEnds.Add(TraceEnd);
 
-					UTypes::AddEffectBySurfaceType(Hit.GetActor(), Hit.BoneName, ProjectileInfo.Effect, mySurfacetype);
-					UGameplayStatics::ApplyPointDamage(Hit.GetActor(), WeaponSetting.ProjectileSetting.ProjectileDamage, Hit.TraceStart, Hit, GetInstigatorController(), this, NULL);
+#if ENABLE_DRAW_DEBUG
+				if (DebugWeaponShow)
+				{
+					DrawDebugLine(GetWorld(), SpawnLocation, TraceEnd, FColor::Red, false, 5.0f);
 				}
+#endif
 			}
 		}
+
+		if (TraceEnds.Num() > 0)
+		{
+			FireHitscan(SpawnLocation, TraceEnds, ShotImpacts);
+		}
+
+		if (ProjectileShot.Directions.Num() > 0)
+		{
+			ProjectileShot.Origin = SpawnLocation;
+			ProjectileShot.Speed = ProjectileInfo.ProjectileInitSpeed;
+			ProjectileShot.ServerTime = GetWorld()->GetTimeSeconds();
+			ProjectileShot_Multicast(ProjectileShot);
+		}
+
+		if (ShotImpacts.Num() > 0)
+		{
+			ShotImpacts_Multicast(ShotImpacts);
+		}
 	}
 
 	if (GetWeaponRound() <= 0 && !WeaponReloading)
@@ -325,84 +443,235 @@ void AWeaponDefault::Fire()
 	}
 }
 
+void AWeaponDefault::FireHitscan(const FVector& Start, const TArray<FVector>& TraceEnds, TArray<FTPSShotImpact>& OutImpacts)
+{
+	FCollisionQueryParams TraceParams(SCENE_QUERY_STAT(WeaponHitscan), false, this);
+	TraceParams.bReturnPhysicalMaterial = true;
+
+	//targets near rays moved back to time shooter saw them, so traces must be done before restore
+	UTPSLagCompensationSubsystem* myLagCompensation = GetWorld()->GetSubsystem<UTPSLagCompensationSubsystem>();
+	const float ShotTime = WeaponSimulation ? WeaponSimulation->GetShotTime() : GetWorld()->GetTimeSeconds();
+	const bool bRewound = myLagCompensation && myLagCompensation->RewindForShot(GetInstigator(), Start, TraceEnds, ShotTime) > 0;
+
+	//rewind move only physics bodies, component bounds used by broadphase stay at present
+	TArray<bool> DynamicRays;
+	const bool bBroadphase = WeaponPelletBroadphase && TraceEnds.Num() > 1 && !bRewound;
+	if (bBroadphase)
+	{
+		FTPSPelletBroadphase::FindDynamicRays(GetWorld(), Start, TraceEnds, GetHitscanTraceChannel(), TraceParams, DynamicRays);
+	}
+	FCollisionQueryParams StaticTraceParams(TraceParams);
+	StaticTraceParams.MobilityType = EQueryMobilityType::Static;
+
+	if (WeaponSetting.bAsyncTrace && !bRewound)
+	{
+		//all pellets of shot resolved together in OnHitscanTraceDone
+		const uint32 ShotId = ++LastHitscanShotId;
+		PendingHitscanShots.FindOrAdd(ShotId).PendingTraces = TraceEnds.Num();
+
+		for (int32 i = 0; i < TraceEnds.Num(); i++)
+		{
+			GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, TraceEnds[i], GetHitscanTraceChannel(), (!bBroadphase || DynamicRays[i]) ? TraceParams : StaticTraceParams,
+				FCollisionResponseParams::DefaultResponseParam, &HitscanTraceDelegate, ShotId);
+		}
+		return;
+	}
+
+	TArray<FHitResult> Hits;
+	Hits.SetNum(TraceEnds.Num());
+	for (int32 i = 0; i < TraceEnds.Num(); i++)
+	{
+		GetWorld()->LineTraceSingleByChannel(Hits[i], Start, TraceEnds[i], GetHitscanTraceChannel(), (!bBroadphase || DynamicRays[i]) ? TraceParams : StaticTraceParams);
+	}
+
+	if (bRewound)
+	{
+		myLagCompensation->RestoreCharacters();
+	}
+
+	for (const FHitResult& Hit : Hits)
+	{
+		ResolveHitscanHit(Hit, OutImpacts);
+	}
+}
+
+ECollisionChannel AWeaponDefault::GetHitscanTraceChannel() const
+{
+	return UEngineTypes::ConvertToCollisionChannel(ETraceTypeQuery::TraceTypeQuery4);
+}
+
+void AWeaponDefault::ResolveHitscanHit(const FHitResult& Hit, TArray<FTPSShotImpact>& OutImpacts)
+{
+	if (Hit.GetActor() && Hit.PhysMaterial.IsValid())
+	{
+		EPhysicalSurface mySurfacetype = UGameplayStatics::GetSurfaceType(Hit);
+
+		FTPSShotImpact& myImpact = OutImpacts.AddDefaulted_GetRef();
+		myImpact.ImpactPoint = Hit.ImpactPoint;
+		myImpact.ImpactNormal = Hit.ImpactNormal;
+		myImpact.SurfaceType = mySurfacetype;
+		myImpact.HitComponent = Hit.GetComponent();
+
+		UTypes::AddEffectBySurfaceType(Hit.GetActor(), UTPSHitProxyComponent::GetHitBoneName(Hit), WeaponSetting.ProjectileSetting.Effect, mySurfacetype);
+		UGameplayStatics::ApplyPointDamage(Hit.GetActor(), WeaponSetting.ProjectileSetting.ProjectileDamage * UTPSHitProxyComponent::GetDamageMultiplier(Hit), Hit.TraceStart, Hit, GetInstigatorController(), this, NULL);
+	}
+}
+
+void AWeaponDefault::OnHitscanTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FTPSPendingHitscanShot* myShot = PendingHitscanShots.Find(Datum.UserData);
+	if (!myShot)
+		return;
+
+	if (Datum.OutHits.Num() > 0)
+	{
+		ResolveHitscanHit(Datum.OutHits[0], myShot->Impacts);
+	}
+
+	myShot->PendingTraces--;
+	if (myShot->PendingTraces <= 0)
+	{
+		if (myShot->Impacts.Num() > 0)
+		{
+			ShotImpacts_Multicast(myShot->Impacts);
+		}
+		PendingHitscanShots.Remove(Datum.UserData);
+	}
+}
+
+void AWeaponDefault::FirePredicted()
+{
+	//On owning client, only cosmetic and rounds, server do traces and damage
+	if (WeaponSimulation)
+		WeaponSimulation->FireTimer[SimIndex] += WeaponSetting.RateOfFire;
+	AdditionalWeaponInfo.Round = AdditionalWeaponInfo.Round - 1;
+	LocalShotSequence++;
+	LastPredictedShotTime = WeaponSimulation ? WeaponSimulation->GetShotTime() : GetWorld()->GetTimeSeconds();
+	ChangeDispersionByShot();
+
+	PlayFireCosmetics(WeaponSetting.EffectFireWeapon.Get(), WeaponSetting.SoundFireWeapon.Get(), WeaponSetting.AnimWeaponInfo.AnimWeaponFire.Get());
+}
+
+void AWeaponDefault::UpdateStateWeapon(EMovementState NewMovementState)
+{
+	if (IsPredictingOwner())
+	{
+		ApplyMovementState(NewMovementState);
+	}
+	UpdateStateWeapon_OnServer(NewMovementState);
+}
+
 void AWeaponDefault::UpdateStateWeapon_OnServer_Implementation(EMovementState NewMovementState)
+{
+	ApplyMovementState(NewMovementState);
+}
+
+void AWeaponDefault::ApplyMovementState(EMovementState NewMovementState)
 {
 	BlockFire = false;
 
+	float DispersionMax = 1.0f;
+	float DispersionMin = 0.1f;
+	float DispersionRecoil = 0.1f;
+	float DispersionReduction = 0.1f;
+	bool bChangeDispersion = true;
+
 	switch (NewMovementState)
 	{
 	case EMovementState::Aim_State:
 		WeaponAiming = true;
-		CurrentDispersionMax = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimMax;
-		CurrentDispersionMin = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimMin;
-		CurrentDispersionRecoil = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimRecoil;
-		CurrentDispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
+		DispersionMax = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimMax;
+		DispersionMin = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimMin;
+		DispersionRecoil = WeaponSetting.DispersionWeapon.Aim_StateDispersionAimRecoil;
+		DispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
 		break;
 	case EMovementState::AimWalk_State:
 		WeaponAiming = true;
-		CurrentDispersionMax = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimMax;
-		CurrentDispersionMin = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimMin;
-		CurrentDispersionRecoil = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimRecoil;
-		CurrentDispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
+		DispersionMax = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimMax;
+		DispersionMin = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimMin;
+		DispersionRecoil = WeaponSetting.DispersionWeapon.AimWalk_StateDispersionAimRecoil;
+		DispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
 		break;
 	case EMovementState::Walk_State:
 		WeaponAiming = false;
-		CurrentDispersionMax = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimMax;
-		CurrentDispersionMin = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimMin;
-		CurrentDispersionRecoil = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimRecoil;
-		CurrentDispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
+		DispersionMax = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimMax;
+		DispersionMin = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimMin;
+		DispersionRecoil = WeaponSetting.DispersionWeapon.Walk_StateDispersionAimRecoil;
+		DispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
 		break;
 	case EMovementState::Run_State:
 		WeaponAiming = false;
-		CurrentDispersionMax = WeaponSetting.DispersionWeapon.Run_StateDispersionAimMax;
-		CurrentDispersionMin = WeaponSetting.DispersionWeapon.Run_StateDispersionAimMin;
-		CurrentDispersionRecoil = WeaponSetting.DispersionWeapon.Run_StateDispersionAimRecoil;
-		CurrentDispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
+		DispersionMax = WeaponSetting.DispersionWeapon.Run_StateDispersionAimMax;
+		DispersionMin = WeaponSetting.DispersionWeapon.Run_StateDispersionAimMin;
+		DispersionRecoil = WeaponSetting.DispersionWeapon.Run_StateDispersionAimRecoil;
+		DispersionReduction = WeaponSetting.DispersionWeapon.Aim_StateDispersionReduction;
 		break;
 	case EMovementState::Sprint_State:
 		WeaponAiming = false;
 		BlockFire = true;
-		SetWeaponStateFire_OnServer(false);
+		if (HasAuthority())
+			SetWeaponStateFire_OnServer(false);
+		else
+			WeaponFiring = false;
 		//Block Fire
+		bChangeDispersion = false;
 		break;
 	default:
+		bChangeDispersion = false;
 		break;
 	}
+
+	if (bChangeDispersion && WeaponSimulation)
+	{
+		WeaponSimulation->DispersionMax[SimIndex] = DispersionMax;
+		WeaponSimulation->DispersionMin[SimIndex] = DispersionMin;
+		WeaponSimulation->DispersionRecoil[SimIndex] = DispersionRecoil;
+		WeaponSimulation->DispersionReduction[SimIndex] = DispersionReduction;
+	}
+	WakeSimulation();
 }
 
 void AWeaponDefault::ChangeDispersionByShot()
 {
-	CurrentDispersion = CurrentDispersion + CurrentDispersionRecoil;
+	if (WeaponSimulation)
+	{
+		WeaponSimulation->Dispersion[SimIndex] += WeaponSimulation->DispersionRecoil[SimIndex];
+		WakeSimulation();
+	}
 }
 
 float AWeaponDefault::GetCurrentDispersion() const
 {
-	float Result = CurrentDispersion;
+	float Result = WeaponSimulation ? WeaponSimulation->Dispersion[SimIndex] : 0.0f;
 	return Result;
 }
 
-FVector AWeaponDefault::ApplyDispersionToShoot(FVector DirectionShoot) const
+FRandomStream AWeaponDefault::MakeShotStream(int32 Seed, int32 ShotSequence)
 {
-	return FMath::VRandCone(DirectionShoot, GetCurrentDispersion() * PI / 180.f);
+	return FRandomStream((int32)HashCombine(GetTypeHash(Seed), GetTypeHash(ShotSequence)));
 }
 
-FVector AWeaponDefault::GetFireEndLocation() const
+void AWeaponDefault::MakeShotDirections(int32 Seed, int32 ShotSequence, const FVector& ShotDirection, float Dispersion, int32 PelletsNum, TArray<FVector>& OutDirections)
 {
-	bool bShootDirection = false;
-	FVector EndLocation = FVector(0.f);
+	FRandomStream ShotStream = MakeShotStream(Seed, ShotSequence);
+	const float ConeHalfAngle = FMath::DegreesToRadians(Dispersion);
 
-	FVector tmpV = (ShootLocation->GetComponentLocation() - ShootEndLocation);
-
-	if (tmpV.Size() > SizeVectorToChangeShootDirectionLogic)
+	OutDirections.Reset(PelletsNum);
+	for (int32 i = 0; i < PelletsNum; i++)
 	{
-		EndLocation = ShootLocation->GetComponentLocation() + ApplyDispersionToShoot(tmpV.GetSafeNormal()) * -20000.0f;
+		OutDirections.Add(ShotStream.VRandCone(ShotDirection, ConeHalfAngle));
 	}
+}
 
-	else
+FVector AWeaponDefault::GetShotDirection() const
+{
+	FVector tmpV = (ShootLocation->GetComponentLocation() - ShootEndLocation);
+
+	if (tmpV.Size() > SizeVectorToChangeShootDirectionLogic)
 	{
-		EndLocation = ShootLocation->GetComponentLocation() + ApplyDispersionToShoot(ShootLocation->GetForwardVector()) * 20000.0f;
+		return -tmpV.GetSafeNormal();
 	}
-	return EndLocation;
+	return ShootLocation->GetForwardVector();
 }
 
 int8 AWeaponDefault::GetNumberProjectileByShot() const
@@ -418,16 +687,18 @@ int32 AWeaponDefault::GetWeaponRound()
 void AWeaponDefault::InitReload()
 {
 	WeaponReloading = true;
-	ReloadTimer = WeaponSetting.ReloadTime;
+	if (WeaponSimulation)
+		WeaponSimulation->ReloadTimer[SimIndex] = WeaponSetting.ReloadTime;
+	WakeSimulation();
 
 	UAnimMontage* AnimToPlay = nullptr;
 	if (WeaponAiming)
 	{
-		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharReloadAim;
+		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharReloadAim.Get();
 	}
 	else
 	{
-		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharReload;
+		AnimToPlay = WeaponSetting.AnimWeaponInfo.AnimCharReload.Get();
 	}
 
 	OnWeaponReloadStart.Broadcast(AnimToPlay);
@@ -435,14 +706,14 @@ void AWeaponDefault::InitReload()
 	UAnimMontage* AnimWeaponToPlay = nullptr;
 	if (WeaponAiming)
 	{
-		AnimWeaponToPlay = WeaponSetting.AnimWeaponInfo.AnimWeaponReloadAim;
+		AnimWeaponToPlay = WeaponSetting.AnimWeaponInfo.AnimWeaponReloadAim.Get();
 	}
 	else
 	{
-		AnimWeaponToPlay = WeaponSetting.AnimWeaponInfo.AnimWeaponReload;
+		AnimWeaponToPlay = WeaponSetting.AnimWeaponInfo.AnimWeaponReload.Get();
 	}
 
-	if (WeaponSetting.AnimWeaponInfo.AnimWeaponReload
+	if (!WeaponSetting.AnimWeaponInfo.AnimWeaponReload.IsNull()
 		&& SkeletalMeshWeapon
 		&& SkeletalMeshWeapon->GetAnimInstance())
 	{
@@ -450,10 +721,10 @@ void AWeaponDefault::InitReload()
 		AnimWeaponStart_Multicast(AnimWeaponToPlay);
 	}
 
-	if (WeaponSetting.ClipDropMesh.DropMesh)
+	if (!WeaponSetting.ClipDropMesh.DropMesh.IsNull() && WeaponSimulation)
 	{
-		DropClipFlag = true;
-		DropClipTimer = WeaponSetting.ClipDropMesh.DropMeshTime;
+		WeaponSimulation->Flags[SimIndex] |= WeaponSim_DropClip;
+		WeaponSimulation->DropClipTimer[SimIndex] = WeaponSetting.ClipDropMesh.DropMeshTime;
 	}
 }
 
@@ -486,7 +757,8 @@ void AWeaponDefault::CancelReload()
 		SkeletalMeshWeapon->GetAnimInstance()->StopAllMontages(0.15f);
 
 	OnWeaponReloadEnd.Broadcast(false, 0);
-	DropClipFlag = false;
+	if (WeaponSimulation)
+		WeaponSimulation->Flags[SimIndex] &= ~WeaponSim_DropClip;
 }
 
 
@@ -531,8 +803,24 @@ int8 AWeaponDefault::GetAviableAmmoForReload()
 	return AviableAmmoForWeapon;
 }
 
-void AWeaponDefault::FXWeaponFire_Multicast_Implementation(UParticleSystem* FxFire, USoundBase* SoundFire)
+void AWeaponDefault::FXWeaponFire_Multicast_Implementation(UParticleSystem* FxFire, USoundBase* SoundFire, UAnimMontage* AnimWeaponFire)
+{
+	//owner already played it in FirePredicted
+	if (IsPredictingOwner())
+		return;
+
+	PlayFireCosmetics(FxFire, SoundFire, AnimWeaponFire);
+}
+
+void AWeaponDefault::PlayFireCosmetics(UParticleSystem* FxFire, USoundBase* SoundFire, UAnimMontage* AnimWeaponFire)
 {
+	if (GetNetMode() == NM_DedicatedServer)
+		return;
+
+	if (AnimWeaponFire)
+	{
+		AnimWeaponStart_Multicast_Implementation(AnimWeaponFire);
+	}
 	if (SoundFire)
 	{
 		UGameplayStatics::SpawnSoundAtLocation(GetWorld(), SoundFire, ShootLocation->GetComponentLocation());
@@ -545,50 +833,20 @@ void AWeaponDefault::FXWeaponFire_Multicast_Implementation(UParticleSystem* FxFi
 
 void AWeaponDefault::ShellDropFire_Multicast_Implementation(UStaticMesh* DropMesh, FTransform Offset, FVector DropImpulseDirection, float LifeTimeMesh, float ImpilseRandomDispersion, float PowerImpulse, float CustomMass, FVector LocalDir)
 {
-	AStaticMeshActor* NewActor = nullptr;
+	UTPSDropMeshSubsystem* myDropMeshSubsystem = GetWorld()->GetSubsystem<UTPSDropMeshSubsystem>();
+	if (!myDropMeshSubsystem)
+		return;
 
-	FActorSpawnParameters Param;
-	Param.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
-	Param.Owner = this;
-
-	NewActor = GetWorld()->SpawnActor<AStaticMeshActor>(AStaticMeshActor::StaticClass(), Offset, Param);
-
-	if (NewActor && NewActor->GetStaticMeshComponent())
+	FVector FinalDir = FVector::ZeroVector;
+	if (!DropImpulseDirection.IsNearlyZero())
 	{
-		NewActor->GetStaticMeshComponent()->SetCollisionProfileName(TEXT("IgnoreOnlyPawn"));
-		NewActor->GetStaticMeshComponent()->SetCollisionEnabled(ECollisionEnabled::PhysicsOnly);
-		NewActor->SetActorTickEnabled(true);
-		NewActor->InitialLifeSpan = LifeTimeMesh;
-		NewActor->GetStaticMeshComponent()->Mobility = EComponentMobility::Movable;
-		NewActor->GetStaticMeshComponent()->SetSimulatePhysics(true);
-		NewActor->GetStaticMeshComponent()->SetStaticMesh(DropMesh);
-
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_GameTraceChannel1, ECollisionResponse::ECR_Ignore);
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_GameTraceChannel2, ECollisionResponse::ECR_Ignore);
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_Pawn, ECollisionResponse::ECR_Ignore);
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_WorldStatic, ECollisionResponse::ECR_Block);
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_WorldDynamic, ECollisionResponse::ECR_Block);
-		NewActor->GetStaticMeshComponent()->SetCollisionResponseToChannel(ECC_PhysicsBody, ECollisionResponse::ECR_Block);
-
-		if (CustomMass > 0.0f)
-		{
-			NewActor->GetStaticMeshComponent()->SetMassOverrideInKg(NAME_None, CustomMass, true);
-		}
-		if (!DropImpulseDirection.IsNearlyZero())
-		{
-			FVector FinalDir;
-			LocalDir = LocalDir + (DropImpulseDirection * 1000.0f);
-
-			if (!FMath::IsNearlyZero(ImpilseRandomDispersion))
-				FinalDir += UKismetMathLibrary::RandomUnitVectorInConeInDegrees(LocalDir, ImpilseRandomDispersion);
-			FinalDir.GetSafeNormal(0.0001f);
+		LocalDir = LocalDir + (DropImpulseDirection * 1000.0f);
 
-			NewActor->GetStaticMeshComponent()->AddImpulse(FinalDir * PowerImpulse);
-			//NewActor->GetStaticMeshComponent()->AddImpulse(MeshWorldPistion.RotateVector(FinalDir * PowerImpulse));
-			//auto cc = FinalDir.GetSafeNormal(0.0001f) * PowerImpulse;
-			//GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Blue, FString::Printf(TEXT("IMPULSE X=%f,  Y=%f, Z=%f, power=%f"), cc.X, cc.Y, cc.Z, PowerImpulse));
-		}
+		if (!FMath::IsNearlyZero(ImpilseRandomDispersion))
+			FinalDir += UKismetMathLibrary::RandomUnitVectorInConeInDegrees(LocalDir, ImpilseRandomDispersion);
 	}
+
+	myDropMeshSubsystem->SpawnDropMesh(DropMesh, Offset, FinalDir * PowerImpulse, LifeTimeMesh, CustomMass);
 }
 
 void AWeaponDefault::InitDropMesh_OnServer_Implementation(UStaticMesh* DropMesh, FTransform Offset, FVector DropImpulseDirection, float LifeTimeMesh, float ImpilseRandomDispersion, float PowerImpulse, float CustomMass)
@@ -619,7 +877,11 @@ void AWeaponDefault::AnimWeaponStart_Multicast_Implementation(UAnimMontage* Anim
 void AWeaponDefault::UpdateWeaponByCharacterMovementState_OnServer_Implementation(FVector NewShootEndLocation, bool NewShouldReduceDispersion)
 {
 	ShootEndLocation = NewShootEndLocation;
-	ShouldReduceDispersion = NewShouldReduceDispersion;
+	if (ShouldReduceDispersion != NewShouldReduceDispersion)
+	{
+		ShouldReduceDispersion = NewShouldReduceDispersion;
+		WakeSimulation();
+	}
 }
 
 void AWeaponDefault::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
@@ -627,25 +889,183 @@ void AWeaponDefault::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLi
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	DOREPLIFETIME(AWeaponDefault, AdditionalWeaponInfo);
+	DOREPLIFETIME_CONDITION(AWeaponDefault, ServerShotSequence, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AWeaponDefault, IdWeaponName, COND_InitialOnly);
+	DOREPLIFETIME_CONDITION(AWeaponDefault, DispersionSeed, COND_InitialOnly);
 }
 
-void AWeaponDefault::ShotgunHitDecal_Multicast_Implementation(UMaterialInterface* DecalMaterial, UPrimitiveComponent* OtherComp, FHitResult HitResult)
+void AWeaponDefault::OnRep_AdditionalWeaponInfo()
 {
-	UGameplayStatics::SpawnDecalAttached(DecalMaterial, FVector(20.0f), OtherComp, NAME_None, HitResult.ImpactPoint, HitResult.ImpactNormal.Rotation(), EAttachLocation::KeepWorldPosition);
+	ServerRound = AdditionalWeaponInfo.Round;
+
+	//server value not count shots still going to server
+	if (IsPredictingOwner())
+	{
+		const int32 NotConfirmedShots = FMath::Max(LocalShotSequence - ServerShotSequence, 0);
+		AdditionalWeaponInfo.Round = FMath::Max(ServerRound - NotConfirmedShots, 0);
+		WakeSimulation();
+	}
 }
 
-void AWeaponDefault::ShotgunHitFX_Multicast_Implementation(UParticleSystem* FxTemplate, FHitResult HitResult)
+void AWeaponDefault::OnRep_IdWeaponName()
 {
-	UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), FxTemplate, FTransform(HitResult.ImpactNormal.Rotation(), HitResult.ImpactPoint, FVector(1.0f)));
+	UTPSGameInstance* myGI = Cast<UTPSGameInstance>(GetGameInstance());
+	if (myGI && !myGI->GetWeaponInfoByName(IdWeaponName, WeaponSetting))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("AWeaponDefault::OnRep_IdWeaponName - Weapon %s not found in table"), *IdWeaponName.ToString());
+	}
+	RequestWeaponAssets();
 }
 
-void AWeaponDefault::ShotgunHitSound_Multicast_Implementation(USoundBase* HitSound, FHitResult HitResult)
+void AWeaponDefault::ShotImpacts_Multicast_Implementation(const TArray<FTPSShotImpact>& Impacts)
 {
-	UGameplayStatics::PlaySoundAtLocation(GetWorld(), HitSound, HitResult.ImpactPoint);
+	UTPSProjectileArchetypeSubsystem* myArchetypes = GetWorld()->GetSubsystem<UTPSProjectileArchetypeSubsystem>();
+	const FTPSProjectileArchetype* myArchetype = myArchetypes ? myArchetypes->GetArchetype(ProjectileArchetype) : nullptr;
+	//client can get impacts before weapon assets are loaded
+	if (GetNetMode() == NM_DedicatedServer || !myArchetype)
+		return;
+
+	for (const FTPSShotImpact& Impact : Impacts)
+	{
+		UTypes::SpawnHitEffects(this, *myArchetype, (EPhysicalSurface)Impact.SurfaceType, Impact.HitComponent, Impact.ImpactPoint, Impact.ImpactNormal);
+	}
 }
 
-void AWeaponDefault::Projectile_Multicast_Implementation(AProjectileDefault* myProjectile, FVector Dir, float ProjectileInitSpeed)
+void AWeaponDefault::ProjectileShot_Multicast_Implementation(const FTPSProjectileShot& Shot)
 {
-	myProjectile->BulletProjectileMovement->InitialSpeed = ProjectileInitSpeed;
-	myProjectile->BulletProjectileMovement->Velocity = Dir * ProjectileInitSpeed;
+	//server already fire not replicated projectiles
+	if (HasAuthority())
+		return;
+
+	//WeaponSetting come by OnRep_IdWeaponName, can still be empty
+	const FProjectileInfo& ProjectileInfo = WeaponSetting.ProjectileSetting;
+	UTPSProjectilePoolSubsystem* myPool = GetWorld()->GetSubsystem<UTPSProjectilePoolSubsystem>();
+	if (!ProjectileInfo.Projectile.Get() || !myPool)
+		return;
+
+	//projectiles already fly on server while event come
+	float ForwardTime = 0.0f;
+	AGameStateBase* myGameState = GetWorld()->GetGameState();
+	if (myGameState)
+	{
+		ForwardTime = FMath::Clamp(myGameState->GetServerWorldTimeSeconds() - Shot.ServerTime, 0.0f, ProjectileCosmeticMaxForwardTime);
+	}
+
+	for (const FVector_NetQuantizeNormal& Dir : Shot.Directions)
+	{
+		const FVector SpawnLocation = Shot.Origin + Dir * Shot.Speed * ForwardTime;
+		AProjectileDefault* myProjectile = myPool->AcquireCosmeticProjectile(ProjectileInfo.Projectile.Get(), SpawnLocation, Dir.Rotation(), GetOwner(), GetInstigator());
+		if (myProjectile)
+		{
+			myProjectile->InitProjectileArchetype(ProjectileArchetype);
+			Projectile_Multicast_Implementation(myProjectile, SpawnLocation, Dir, Shot.Speed);
+		}
+	}
+}
+
+void AWeaponDefault::Projectile_Multicast_Implementation(AProjectileDefault* myProjectile, FVector SpawnLocation, FVector Dir, float ProjectileInitSpeed)
+{
+	//projectile actor can still not be replicated to client
+	if (myProjectile)
+	{
+		myProjectile->BulletProjectileMovement->InitialSpeed = ProjectileInitSpeed;
+		myProjectile->ActivateProjectile(SpawnLocation, Dir.Rotation(), Dir * ProjectileInitSpeed);
+	}
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+//golden values are made from seed stream only (hash of seed and shot, then lcg), so they don't depend on platform float math
+//if this fail after engine update or change in MakeShotStream, clients of old build will shoot other pellets than server
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTPSWeaponDispersionTest, "TPS.Weapon.Dispersion", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTPSWeaponDispersionTest::RunTest(const FString& Parameters)
+{
+	struct FGoldenShot
+	{
+		int32 Seed;
+		int32 ShotSequence;
+		uint32 First;
+		uint32 Second;
+	};
+	const FGoldenShot GoldenShots[] =
+	{
+		{ 12345, 0, 0x3f516db7u, 0xe27c764eu },
+		{ 12345, 1, 0x0c59cd63u, 0xefd0f4eau },
+		{ -7, 1000, 0xc45997bfu, 0x5e7149f6u },
+		{ MAX_int32, 42, 0x56b8da64u, 0x7ae62a1fu },
+	};
+	for (const FGoldenShot& Golden : GoldenShots)
+	{
+		FRandomStream ShotStream = AWeaponDefault::MakeShotStream(Golden.Seed, Golden.ShotSequence);
+		const uint32 First = ShotStream.GetUnsignedInt();
+		const uint32 Second = ShotStream.GetUnsignedInt();
+		TestTrue(FString::Printf(TEXT("stream of seed %d shot %d is %08x %08x"), Golden.Seed, Golden.ShotSequence, First, Second),
+			First == Golden.First && Second == Golden.Second);
+	}
+
+	const int32 Seed = 12345;
+	const int32 Shots = 1000;
+	const uint32 GoldenChecksum = 0x04f06b75u;
+	const FVector ShotDirection = FVector(1.0f, 0.5f, 0.1f).GetSafeNormal();
+
+	uint32 Checksum = 0;
+	int32 Mismatches = 0;
+	TArray<FVector> ServerDirections;
+	TArray<FVector> ClientDirections;
+	for (int32 ShotSequence = 0; ShotSequence < Shots; ShotSequence++)
+	{
+		FRandomStream ShotStream = AWeaponDefault::MakeShotStream(Seed, ShotSequence);
+		Checksum = HashCombine(Checksum, ShotStream.GetUnsignedInt());
+		Checksum = HashCombine(Checksum, ShotStream.GetUnsignedInt());
+
+		const float Dispersion = 0.5f + (ShotSequence % 10);
+		const int32 PelletsNum = 1 + ShotSequence % 8;
+		AWeaponDefault::MakeShotDirections(Seed, ShotSequence, ShotDirection, Dispersion, PelletsNum, ServerDirections);
+
+		//server side, seed and shot go same as replicated int properties, pellets only for compare
+		FNetBitWriter Writer(nullptr, 2048);
+		int32 SentSeed = Seed;
+		int32 SentShotSequence = ShotSequence;
+		Writer << SentSeed;
+		Writer << SentShotSequence;
+		bool bSuccess = true;
+		for (const FVector& Direction : ServerDirections)
+		{
+			FVector_NetQuantizeNormal SentDirection(Direction);
+			SentDirection.NetSerialize(Writer, nullptr, bSuccess);
+		}
+
+		//client side, rebuild from what was read and quantize same way
+		FNetBitReader Reader(nullptr, Writer.GetData(), Writer.GetNumBits());
+		int32 ReadSeed = 0;
+		int32 ReadShotSequence = 0;
+		Reader << ReadSeed;
+		Reader << ReadShotSequence;
+		AWeaponDefault::MakeShotDirections(ReadSeed, ReadShotSequence, ShotDirection, Dispersion, PelletsNum, ClientDirections);
+
+		bool bMatch = bSuccess && !Writer.IsError() && ClientDirections.Num() == ServerDirections.Num();
+		for (int32 i = 0; bMatch && i < ClientDirections.Num(); i++)
+		{
+			FVector_NetQuantizeNormal ReadDirection;
+			ReadDirection.NetSerialize(Reader, nullptr, bSuccess);
+
+			FNetBitWriter ClientWriter(nullptr, 64);
+			FVector_NetQuantizeNormal ClientDirection(ClientDirections[i]);
+			ClientDirection.NetSerialize(ClientWriter, nullptr, bSuccess);
+			FNetBitReader ClientReader(nullptr, ClientWriter.GetData(), ClientWriter.GetNumBits());
+			FVector_NetQuantizeNormal QuantizedClientDirection;
+			QuantizedClientDirection.NetSerialize(ClientReader, nullptr, bSuccess);
+
+			bMatch = bSuccess && !Reader.IsError() && ReadDirection == QuantizedClientDirection;
+		}
+		if (!bMatch)
+		{
+			Mismatches++;
+		}
+	}
+
+	TestEqual(TEXT("client rebuilt pellets differ from server"), Mismatches, 0);
+	TestTrue(FString::Printf(TEXT("stream checksum of seed %d, %d shots is %08x, golden %08x"), Seed, Shots, Checksum, GoldenChecksum), Checksum == GoldenChecksum);
+	return true;
 }
+#endif
@@ -3,11 +3,19 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Components/ArrowComponent.h"
+#include "WorldCollision.h"
 
 #include "../FuncLibrary/Types.h"
 #include "ProjectileDefault.h"
 #include "WeaponDefault.generated.h"
 
+//async trace pellets of one shot, impacts are sent when last trace is done
+struct FTPSPendingHitscanShot
+{
+	int32 PendingTraces = 0;
+	TArray<FTPSShotImpact> Impacts;
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnWeaponFireStart, UAnimMontage*, Anim);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnWeaponReloadStart, UAnimMontage*, Anim);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnWeaponReloadEnd, bool, bIsSuccess, int32, AmmoSafe);
@@ -36,55 +44,103 @@ public:
 
 	UPROPERTY(VisibleAnywhere)
 	FWeaponInfo WeaponSetting;
-	UPROPERTY(Replicated, EditAnywhere, BlueprintReadWrite, Category = "Weapon Info")
+	UPROPERTY(ReplicatedUsing = OnRep_AdditionalWeaponInfo, EditAnywhere, BlueprintReadWrite, Category = "Weapon Info")
 	FAdditionalWeaponInfo AdditionalWeaponInfo;
+	UFUNCTION()
+	void OnRep_AdditionalWeaponInfo();
 	//UPROPERTY(Replicated, EditAnywhere)
 	//FProjectileInfo ProjectileInfo;
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
-	// Tick func
-	virtual void Tick(float DeltaTime) override;
+	//timers and dispersion are simulated by UTPSWeaponSimulationSubsystem, weapon don't tick
+	UPROPERTY()
+	class UTPSWeaponSimulationSubsystem* WeaponSimulation = nullptr;
+	int32 SimIndex = INDEX_NONE;
+	void WakeSimulation();
 
-	void FireTick(float DeltaTime);
-	void ReloadTick(float DeltaTime);
-	void DispersionTick(float DeltaTime);
-	void ClipDropTick(float DeltaTime);
-	void ShellDropTick(float DeltaTime);
+	void DropClipMesh();
+	void DropShellMesh();
 
 	void WeaponInit();
-
+	//weapon of not current inventory slot is kept hidden and net dormant instead of destroy
+	void SetWeaponActive(bool bActive);
+	//after WeaponSetting init, prepare projectiles for first shots
+	void WarmUpProjectilePool();
+	//stream soft assets of IdWeaponName, weapon can't fire until they are loaded
+	void RequestWeaponAssets();
+	void OnWeaponAssetsLoaded();
+	FName StreamedWeaponName;
+	bool bWeaponAssetsLoaded = false;
+	//fire pressed while assets are streaming, start when they come
+	bool bFireOnAssetsLoaded = false;
+	//shared projectile setting in UTPSProjectileArchetypeSubsystem, made when assets are loaded
+	int32 ProjectileArchetype = INDEX_NONE;
+
+	//local prediction on owning client and server request
+	void SetWeaponStateFire(bool bIsFire);
 	UFUNCTION(Server, Reliable, BlueprintCallable)
 	void SetWeaponStateFire_OnServer(bool bIsFire);
 
 	bool CheckWeaponCanFire();
 
 	FProjectileInfo GetProjectile();
+	//projectile is simulated by UTPSVirtualBulletSubsystem, explosive projectile is always actor
+	bool IsVirtualProjectile() const;
+	//server projectile is not replicated, clients spawn cosmetic copy by ProjectileShot_Multicast
+	bool IsLocalCosmeticProjectile() const;
 
 	void Fire();
 
+	//Fire prediction
+	bool IsPredictingOwner() const;
+	void FirePredicted();
+	void PredictionResyncTick();
+	void PlayFireCosmetics(UParticleSystem* FxFire, USoundBase* SoundFire, UAnimMontage* AnimWeaponFire);
+	//shots fired by server, owner compare it with his predicted shots
+	UPROPERTY(Replicated)
+	int32 ServerShotSequence = 0;
+	int32 LocalShotSequence = 0;
+	int32 ServerRound = 0;
+	float LastPredictedShotTime = 0.0f;
+
+	void UpdateStateWeapon(EMovementState NewMovementState);
 	UFUNCTION(Server, Reliable)
 	void UpdateStateWeapon_OnServer(EMovementState NewMovementState);
+	void ApplyMovementState(EMovementState NewMovementState);
 	void ChangeDispersionByShot();
 	float GetCurrentDispersion() const;
-	FVector ApplyDispersionToShoot(FVector DirectionShoot)const;
 
-	FVector GetFireEndLocation()const;
+	//pellets are made by stream from seed and shot number, so client can repeat server shot
+	UPROPERTY(Replicated)
+	int32 DispersionSeed = 0;
+	static FRandomStream MakeShotStream(int32 Seed, int32 ShotSequence);
+	static void MakeShotDirections(int32 Seed, int32 ShotSequence, const FVector& ShotDirection, float Dispersion, int32 PelletsNum, TArray<FVector>& OutDirections);
+	//direction to ShootEndLocation without dispersion
+	FVector GetShotDirection() const;
 	int8 GetNumberProjectileByShot() const;
 
-	//Timers
-	float FireTimer = 0.0f;
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ReloadLogic")
-	float ReloadTimer = 0.0f;
+	//hitscan
+	void FireHitscan(const FVector& Start, const TArray<FVector>& TraceEnds, TArray<FTPSShotImpact>& OutImpacts);
+	ECollisionChannel GetHitscanTraceChannel() const;
+	void ResolveHitscanHit(const FHitResult& Hit, TArray<FTPSShotImpact>& OutImpacts);
+	void OnHitscanTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+	FTraceDelegate HitscanTraceDelegate;
+	TMap<uint32, FTPSPendingHitscanShot> PendingHitscanShots;
+	uint32 LastHitscanShotId = 0;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FRotator MeshWorldPistion;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FireLogic")
+	UPROPERTY(ReplicatedUsing = OnRep_IdWeaponName, EditAnywhere, BlueprintReadWrite, Category = "FireLogic")
 	FName IdWeaponName;
+	//client need WeaponSetting for hit fx, take it from table by name
+	UFUNCTION()
+	void OnRep_IdWeaponName();
 
 	//flags
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FireLogic")
@@ -97,19 +153,6 @@ public:
 	//Dispersion
 	UPROPERTY(Replicated)
 	bool ShouldReduceDispersion = false;
-	float CurrentDispersion = 0.0f;
-	float CurrentDispersionMax = 1.0f;
-	float CurrentDispersionMin = 0.1f;
-	float CurrentDispersionRecoil = 0.1f;
-	float CurrentDispersionReduction = 0.1f;
-
-	//Timer Drop Magazine on Reload
-	bool DropClipFlag = false;
-	float DropClipTimer = -1.0f;
-
-	//shell Flag
-	bool DropShellFlag = false;
-	float DropShellTimer = -1.0f;
 
 	UPROPERTY(Replicated)
 	FVector ShootEndLocation = FVector(0);
@@ -142,13 +185,13 @@ public:
 	void ShellDropFire_Multicast(UStaticMesh* DropMesh, FTransform Offset, FVector DropImpulseDirection, float LifeTimeMesh, float ImpilseRandomDispersion, float PowerImpulse, float CustomMass, FVector LocalDir);
 
 	UFUNCTION(NetMulticast, Unreliable)
-	void FXWeaponFire_Multicast(UParticleSystem* FxFire, USoundBase* SoundFire);
+	void FXWeaponFire_Multicast(UParticleSystem* FxFire, USoundBase* SoundFire, UAnimMontage* AnimWeaponFire);
+	//all trace hits of one shot
 	UFUNCTION(NetMulticast, Unreliable)
-	void ShotgunHitDecal_Multicast(UMaterialInterface* DecalMaterial, UPrimitiveComponent* OtherComp, FHitResult HitResult);
-	UFUNCTION(NetMulticast, Unreliable)
-	void ShotgunHitFX_Multicast(UParticleSystem* FxTemplate, FHitResult HitResult);
-	UFUNCTION(NetMulticast, Unreliable)
-	void ShotgunHitSound_Multicast(USoundBase* HitSound, FHitResult HitResult);
+	void ShotImpacts_Multicast(const TArray<FTPSShotImpact>& Impacts);
 	UFUNCTION(NetMulticast, Reliable)
-	void Projectile_Multicast(AProjectileDefault* myProjectile, FVector Dir, float ProjectileInitSpeed);
+	void Projectile_Multicast(AProjectileDefault* myProjectile, FVector SpawnLocation, FVector Dir, float ProjectileInitSpeed);
+	//all projectiles of one shot with TPS.Projectile.LocalCosmetic
+	UFUNCTION(NetMulticast, Unreliable)
+	void ProjectileShot_Multicast(const FTPSProjectileShot& Shot);
 };